@@ -50,6 +50,31 @@ struct WorkingSetElement {
 	unsigned int time_stamp ;
 };
 
+//a zero-fill-on-demand region of the user heap: its pages get a frame at their first access
+//and a page file slot at their first eviction
+struct AnonRegion {
+	uint32 start;	//first virtual address of the region
+	uint32 end;	//first virtual address after the region
+	LIST_ENTRY(AnonRegion) prev_next_info;
+};
+LIST_HEAD(AnonRegion_List, AnonRegion);
+
+//access hints of sys_madvise() for a range of the user memory
+#define MADV_NORMAL	0	//no hint (removes the hint of the range)
+#define MADV_RANDOM	1	//no read ahead, the pages are not dropped behind the accesses
+#define MADV_SEQUENTIAL	2	//read ahead after each fault, the pages behind the faults are the first victims
+#define MADV_WILLNEED	3	//load the pages of the range now
+#define MADV_DONTNEED	4	//drop the pages of the range, they come back zeroed
+#define MAX_MEM_ADVICES	16
+
+//a range of the user memory with an access hint (RANDOM or SEQUENTIAL)
+struct MemAdvice {
+	uint32 start;	//first virtual address of the range
+	uint32 end;	//first virtual address after the range
+	uint32 advice;	//MADV_NORMAL if the entry is not used
+	uint32 last_fault;	//last faulted address of a SEQUENTIAL range
+};
+
 struct Env {
 	struct Trapframe env_tf;	// Saved registers
 	LIST_ENTRY(Env) prev_next_info;	// Free list link pointers
@@ -88,6 +113,10 @@ struct Env {
 
 	uint32 pageFaultsCounter;
 	uint32 tableFaultsCounter;
+	//pages read from the page file (the buffered pages are reclaimed without reading them)
+	uint32 pageFileReadsCounter;
+	//disk transfers of these reads (the consecutive pages on consecutive disk frames are read together)
+	uint32 pageFileTransfersCounter;
 
 	uint32 nModifiedPages;
 	uint32 nNotModifiedPages;
@@ -100,6 +129,14 @@ struct Env {
 
 	//2016
 	struct WorkingSetElement* __uptr_pws;
+
+	//zero-fill-on-demand regions allocated by allocateMem()
+	struct AnonRegion_List anon_regions;
+	//pages of the regions without a page file slot, their slots are reserved in the page file
+	uint32 anon_reserved_pages;
+
+	//ranges with access hints given by sys_madvise(), MAX_MEM_ADVICES entries kmalloc'ed on the first hint
+	struct MemAdvice* mem_advices;
 };
 
 #define LOG2NENV		10
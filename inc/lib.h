@@ -50,6 +50,10 @@ uint32 	sys_calculate_notmod_frames();
 
 void 	sys_freeMem(uint32 virtual_address, uint32 size);
 void	sys_allocateMem(uint32 virtual_address, uint32 size);
+void	sys_allocateMem_prefault(uint32 virtual_address, uint32 size);
+int	sys_madvise(uint32 virtual_address, uint32 size, uint32 advice);
+int	sys_uheap_trace(struct uheapTraceEvent* event);
+int	sys_trimMem(uint32 virtual_address, uint32 size);
 void 	sys_moveMem(uint32 src_virtual_address, uint32 dst_virtual_address, uint32 size);
 
 int 	sys_pf_calculate_allocated_pages(void);
@@ -83,6 +87,7 @@ uint32 sys_calculate_free_frames();
 uint32 sys_calculate_modified_frames();
 void sys_run_env();
 struct uint64 sys_get_virtual_time();
+uint32 get_virtual_time_since(struct uint64 start);
 
 uint32 sys_isUHeapPlacementStrategyFIRSTFIT();
 uint32 sys_isUHeapPlacementStrategyBESTFIT();
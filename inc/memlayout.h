@@ -208,6 +208,21 @@ struct Frame_Info {
 	uint32 va;
 	struct Env *environment;
 	unsigned char isBuffered;
+
+	// kheap_va is the kernel heap virtual address this frame is mapped at
+	// (0 if the frame is not a kernel heap frame). It is set when the frame is
+	// mapped in the kernel heap (kmalloc, krealloc) and cleared when it is
+	// unmapped from there, so that kheap_virtual_address() is a direct lookup.
+	uint32 kheap_va;
+
+	// buddyOrder is order + 1 if the frame is the first frame of a free block
+	// of 2^order contiguous frames in frame_buddy_lists, 0 otherwise.
+	unsigned char buddyOrder;
+
+	// ws_index is the index of the working set entry of the user page mapped
+	// to this frame. It is set by env_page_ws_set_entry() and checked against
+	// the entry before use, so a stale value is harmless.
+	uint32 ws_index;
 };
 
 #endif /* !__ASSEMBLER__ */
@@ -44,6 +44,9 @@ enum
 	SYS_chktst,
 	SYS_get_heap_strategy,
 	SYS_set_heap_strategy,
+	SYS_madvise,
+	SYS_uheap_trace,
+	SYS_trimMem,
 	NSYSCALLS
 };
 
@@ -11,5 +11,23 @@
 void *malloc(uint32 size);
 void free(void* virtual_address);
 void *realloc(void *virtual_address, uint32 new_size);
+void *calloc(uint32 n, uint32 size);
+void *malloc_populate(uint32 size);
+
+//Tracing of the user heap calls (kernel commands: uheaptrace, uheapstats)
+#define UHT_MALLOC	0x1
+#define UHT_FREE	0x2
+#define UHT_REALLOC	0x3
+
+struct uheapTraceEvent {
+	uint8 type;		//UHT_MALLOC, UHT_FREE or UHT_REALLOC
+	uint8 strategy;		//UHP_PLACE_... of the call
+	uint16 searchSteps;	//blocks visited to find the space of the call
+	uint32 size;		//requested size (the freed size for free())
+	uint32 address;		//returned address (the freed address for free())
+	uint32 caller;		//return address of the call
+	uint32 freePages;	//free pages of the heap after the call
+	uint32 largestFreePages;	//pages of the largest free block after the call
+};
 
 #endif
@@ -27,6 +27,8 @@ FUNCTIONS:	readline, cprintf, execute_command, run_command_prompt, command_kerne
 #include <kern/file_manager.h>
 #include <kern/sched.h>
 #include <kern/kheap.h>
+#include <kern/kmem_cache.h>
+#include <kern/uheap_trace.h>
 
 
 //Structure for each command
@@ -51,6 +53,7 @@ int command_readuserblock(int number_of_arguments, char **arguments);
 int command_remove_table(int number_of_arguments, char **arguments);
 int command_allocuserpage(int number_of_arguments, char **arguments);
 int command_meminfo(int number_of_arguments, char **arguments);
+int command_kheap_info(int number_of_arguments, char **arguments);
 
 int command_set_page_rep_FIFO(int number_of_arguments, char **arguments);
 int command_set_page_rep_CLOCK(int number_of_arguments, char **arguments);
@@ -64,6 +67,14 @@ int command_set_heap_plac_NEXTFIT(int number_of_arguments, char **arguments);
 int command_set_heap_plac_WORSTFIT(int number_of_arguments, char **arguments);
 int command_print_heap_plac(int number_of_arguments, char **arguments);
 
+int command_set_kheap_plac_CONTINUOUS(int number_of_arguments, char **arguments);
+int command_set_kheap_plac_FIRSTFIT(int number_of_arguments, char **arguments);
+int command_set_kheap_plac_BESTFIT(int number_of_arguments, char **arguments);
+int command_set_kheap_plac_NEXTFIT(int number_of_arguments, char **arguments);
+int command_print_kheap_plac(int number_of_arguments, char **arguments);
+int command_disable_kheap_buddy(int number_of_arguments, char **arguments);
+int command_enable_kheap_buddy(int number_of_arguments, char **arguments);
+
 int command_disable_modified_buffer(int number_of_arguments, char **arguments);
 int command_enable_modified_buffer(int number_of_arguments, char **arguments);
 
@@ -74,17 +85,44 @@ int command_enable_buffering(int number_of_arguments, char **arguments);
 int command_set_modified_buffer_length(int number_of_arguments, char **arguments);
 int command_get_modified_buffer_length(int number_of_arguments, char **arguments);
 
+int command_disable_zero_page_sharing(int number_of_arguments, char **arguments);
+int command_enable_zero_page_sharing(int number_of_arguments, char **arguments);
+
+int command_disable_uheap_tracing(int number_of_arguments, char **arguments);
+int command_enable_uheap_tracing(int number_of_arguments, char **arguments);
+int command_uheap_stats(int number_of_arguments, char **arguments);
+
 //2016: Kernel Heap Tests
 extern int test_kmalloc();
 extern int test_kfree();
 extern int test_kheap_phys_addr();
 extern int test_kheap_virt_addr();
 extern int test_three_creation_functions();
+extern int test_kheap_virt_addr_time();
+extern int test_kheap_placement();
+extern int test_kheap_buddy();
+extern int test_kmalloc_map_time();
+extern int test_krealloc();
+extern int test_kmalloc_reserve();
+extern int test_zeroed_frames();
+extern int test_allocate_frames();
+extern int test_kmem_cache();
+extern int test_kmalloc_small();
 int command_test_kmalloc(int number_of_arguments, char **arguments);
 int command_test_kfree(int number_of_arguments, char **arguments);
 int command_test_kheap_phys_addr(int number_of_arguments, char **arguments);
 int command_test_kheap_virt_addr(int number_of_arguments, char **arguments);
 int command_test_three_creation_functions(int number_of_arguments, char **arguments);
+int command_test_kheap_virt_addr_time(int number_of_arguments, char **arguments);
+int command_test_kheap_placement(int number_of_arguments, char **arguments);
+int command_test_kheap_buddy(int number_of_arguments, char **arguments);
+int command_test_kmalloc_map_time(int number_of_arguments, char **arguments);
+int command_test_krealloc(int number_of_arguments, char **arguments);
+int command_test_kmalloc_reserve(int number_of_arguments, char **arguments);
+int command_test_zeroed_frames(int number_of_arguments, char **arguments);
+int command_test_allocate_frames(int number_of_arguments, char **arguments);
+int command_test_kmem_cache(int number_of_arguments, char **arguments);
+int command_test_kmalloc_small(int number_of_arguments, char **arguments);
 
 //Array of commands. (initialized)
 struct Command commands[] =
@@ -100,6 +138,7 @@ struct Command commands[] =
 		{ "rut", "", command_remove_table},
 		{ "aup", "", command_allocuserpage},
 		{ "meminfo", "", command_meminfo},
+		{ "kheapinfo", "kernel heap usage, free extents, fragmentation and allocations per caller", command_kheap_info},
 
 		{ "run", "runs a single user program", command_run_program },
 		{"load", "load a single user program to mem with status = NEW", commnad_load_env},
@@ -118,6 +157,14 @@ struct Command commands[] =
 		{"worstfit", "set heap placement strategy to WORST FIT", command_set_heap_plac_WORSTFIT},
 		{"heap?", "print current heap placement strategy", command_print_heap_plac},
 
+		{"kcontinuous", "set kernel heap placement strategy to CONTINUOUS", command_set_kheap_plac_CONTINUOUS},
+		{"kfirstfit", "set kernel heap placement strategy to FIRST FIT", command_set_kheap_plac_FIRSTFIT},
+		{"kbestfit", "set kernel heap placement strategy to BEST FIT", command_set_kheap_plac_BESTFIT},
+		{"knextfit", "set kernel heap placement strategy to NEXT FIT", command_set_kheap_plac_NEXTFIT},
+		{"kheap?", "print current kernel heap placement strategy", command_print_kheap_plac},
+		{"nokbuddy", "use the placement strategy for the kernel heap (heap must be empty)", command_disable_kheap_buddy},
+		{"kbuddy", "use the buddy mode for the kernel heap (heap must be empty)", command_enable_kheap_buddy},
+
 		//2016
 		{"nobuff", "", command_disable_buffering},
 		{"buff", "", command_enable_buffering},
@@ -128,11 +175,28 @@ struct Command commands[] =
 		{"modbufflength?", "", command_get_modified_buffer_length},
 		{"modbufflength", "", command_set_modified_buffer_length},
 
+		{"nozeropage", "reads from untouched user heap pages take private zeroed frames", command_disable_zero_page_sharing},
+		{"zeropage", "reads from untouched user heap pages share the zero frame until their first write", command_enable_zero_page_sharing},
+
+		{"nouheaptrace", "stop tracing the user heap calls", command_disable_uheap_tracing},
+		{"uheaptrace", "trace the user heap calls of the next programs (the old traces are removed)", command_enable_uheap_tracing},
+		{"uheapstats", "user heap traces: list them, or sizes, search steps, callers and fragmentation of the given env id", command_uheap_stats},
+
 		{"tstkmalloc", "Kernel Heap: test kmalloc (return address, size, mem access...etc)", command_test_kmalloc},
 		{"tstkfree", "Kernel Heap: test kfree (freed frames, mem access...etc)", command_test_kfree},
 		{"tstkphysaddr", "Kernel Heap: test kheap_phys_addr", command_test_kheap_phys_addr},
 		{"tstkvirtaddr", "Kernel Heap: test kheap_virt_addr", command_test_kheap_virt_addr},
 		{"tst3functions", "Env Load: test the creation of new dir, tables and pages WS", command_test_three_creation_functions},
+		{"tstkvirtaddrtime", "Kernel Heap: measure kheap_virt_addr cost as the heap grows", command_test_kheap_virt_addr_time},
+		{"tstkplacement", "Kernel Heap: test FIRST/BEST/NEXT FIT placement and coalescing", command_test_kheap_placement},
+		{"tstkbuddy", "Kernel Heap: test the buddy mode (aligned blocks, split and merge)", command_test_kheap_buddy},
+		{"tstkmaptime", "Kernel Heap: measure kmalloc mapping cost page by page vs. in one pass", command_test_kmalloc_map_time},
+		{"tstkrealloc", "Kernel Heap: test krealloc (in place, moved without copy, small objects)", command_test_krealloc},
+		{"tstkreserve", "Kernel Heap: test kmalloc_reserve (pages mapped on their first access)", command_test_kmalloc_reserve},
+		{"tstzeroframes", "Memory: test the zeroed frames pool (allocate_zeroed_frame and kmalloc_zeroed)", command_test_zeroed_frames},
+		{"tstframes", "Memory: test allocate_frames and free_frames (blocks of contiguous frames)", command_test_allocate_frames},
+		{"tstkmemcache", "Kernel Heap: test kmem_cache object reuse and reaping", command_test_kmem_cache},
+		{"tstkmallocsmall", "Kernel Heap: test sub-page kmalloc size classes", command_test_kmalloc_small},
 };
 
 //Number of commands = size of the array / size of command structure
@@ -574,8 +638,75 @@ int command_allocuserpage(int number_of_arguments, char **arguments)
 int command_meminfo(int number_of_arguments, char **arguments)
 {
 	struct freeFramesCounters counters =calculate_available_frames();
-	cprintf("Total available frames = %d\nFree Buffered = %d\nFree Not Buffered = %d\nModified = %d\n",
-			counters.freeBuffered+ counters.freeNotBuffered+ counters.modified, counters.freeBuffered, counters.freeNotBuffered, counters.modified);
+	cprintf("Total available frames = %d\nFree Buffered = %d\nFree Not Buffered = %d\nModified = %d\nCached = %d\n",
+			counters.freeBuffered+ counters.freeNotBuffered+ counters.modified+ counters.cached, counters.freeBuffered, counters.freeNotBuffered, counters.modified, counters.cached);
+	cprintf("Zeroed = %d (zeroed frame allocations: %d from the pool, %d zeroed on demand)\n",
+			counters.zeroed, zeroedFrameHits, zeroedFrameMisses);
+	cprintf("Free blocks of contiguous frames (order: blocks) =");
+	int order;
+	for (order = 1; order <= FRAME_BUDDY_MAX_ORDER; order++)
+		cprintf(" %d:%d", order, LIST_SIZE(&frame_buddy_lists[order]));
+	cprintf("\n");
+	kmem_cache_print();
+
+	//small kernel objects (kmalloc size classes) used to take a frame each
+	cprintf("Frames saved by small kernel objects = %d\n", kmem_cache_small_frames_saved());
+	int i;
+	uint32 advicesBytes = MAX_MEM_ADVICES * sizeof(struct MemAdvice);
+	for (i = 0; i < NENV; i++)
+	{
+		struct Env* e = &envs[i];
+		if (e->env_status == ENV_FREE || e->mem_advices == NULL)
+			continue;
+		cprintf("  [%d] %s: advice table of %d bytes, %d of %d bytes of its frame saved\n", e->env_id, e->prog_name,
+				advicesBytes, PAGE_SIZE - kmalloc_size_class(advicesBytes)->object_size, PAGE_SIZE);
+	}
+	return 0;
+}
+
+int command_kheap_info(int number_of_arguments, char **arguments)
+{
+	struct kheapFreeStats stats;
+	kheapGetFreeStats(&stats);
+
+	uint32 usedPages = KHEAP_PAGES - stats.freePages;
+	cprintf("Kernel heap (%s): %d KB\n", isKHeapBuddyEnabled() ? "BUDDY" : "extents", KHEAP_PAGES * (PAGE_SIZE/1024));
+	cprintf("Used = %d KB (%d KB mapped, %d KB reserved not touched yet), Free = %d KB\n", usedPages * (PAGE_SIZE/1024),
+			(kheapUsedPages - kheapLazyPages) * (PAGE_SIZE/1024), kheapLazyPages * (PAGE_SIZE/1024), stats.freePages * (PAGE_SIZE/1024));
+
+	//fragmentation: the part of the free pages that is not in the largest extent
+	uint32 fragmentation = 0;
+	if (stats.freePages > 0)
+		fragmentation = 100 - stats.largestExtent * 100 / stats.freePages;
+	cprintf("Free extents = %d, largest = %d KB, fragmentation = %d%%\n", stats.freeExtents,
+			stats.largestExtent * (PAGE_SIZE/1024), fragmentation);
+
+	cprintf("free extent size (pages)\tcount\n");
+	int i;
+	for (i = 0; i < KHEAP_HISTOGRAM_BUCKETS; i++)
+	{
+		if (stats.histogram[i] == 0)
+			continue;
+		cprintf("%d - %d\t\t\t\t%d\n", 1 << i, (2 << i) - 1, stats.histogram[i]);
+	}
+
+	//small objects are counted by the slab pages of their cache (see meminfo)
+	cprintf("caller\t\t\t\tblocks\tKB\n");
+	for (i = 0; i < numOfKheapCallers; i++)
+	{
+		struct kheapCaller* caller = &kheapCallers[i];
+		if (caller->blocks == 0)
+			continue;
+		if (i == 0)
+		{
+			cprintf("<other callers>\t\t\t%d\t%d\n", caller->blocks, caller->pages * (PAGE_SIZE/1024));
+			continue;
+		}
+		struct Eipdebuginfo info;
+		debuginfo_eip((uint32*)caller->eip, &info);
+		cprintf("%.*s+%d (%s:%d)\t%d\t%d\n", info.eip_fn_namelen, info.eip_fn_name, caller->eip - (uint32)info.eip_fn_addr,
+				info.eip_file, info.eip_line, caller->blocks, caller->pages * (PAGE_SIZE/1024));
+	}
 	return 0;
 }
 
@@ -751,6 +882,70 @@ int command_print_heap_plac(int number_of_arguments, char **arguments)
 	return 0;
 }
 
+int command_set_kheap_plac_CONTINUOUS(int number_of_arguments, char **arguments)
+{
+	setKHeapPlacementStrategyCONTINUOUS();
+	cprintf("Kernel Heap placement strategy is now CONTINUOUS\n");
+	return 0;
+}
+
+int command_set_kheap_plac_FIRSTFIT(int number_of_arguments, char **arguments)
+{
+	setKHeapPlacementStrategyFIRSTFIT();
+	cprintf("Kernel Heap placement strategy is now FIRST FIT\n");
+	return 0;
+}
+
+int command_set_kheap_plac_BESTFIT(int number_of_arguments, char **arguments)
+{
+	setKHeapPlacementStrategyBESTFIT();
+	cprintf("Kernel Heap placement strategy is now BEST FIT\n");
+	return 0;
+}
+
+int command_set_kheap_plac_NEXTFIT(int number_of_arguments, char **arguments)
+{
+	setKHeapPlacementStrategyNEXTFIT();
+	cprintf("Kernel Heap placement strategy is now NEXT FIT\n");
+	return 0;
+}
+
+int command_print_kheap_plac(int number_of_arguments, char **arguments)
+{
+	if (isKHeapBuddyEnabled())
+		cprintf("Kernel Heap is in BUDDY mode\n");
+	else if (isKHeapPlacementStrategyCONTINUOUS())
+		cprintf("Kernel Heap placement strategy is CONTINUOUS\n");
+	else if (isKHeapPlacementStrategyFIRSTFIT())
+		cprintf("Kernel Heap placement strategy is FIRST FIT\n");
+	else if (isKHeapPlacementStrategyBESTFIT())
+		cprintf("Kernel Heap placement strategy is BEST FIT\n");
+	else if (isKHeapPlacementStrategyNEXTFIT())
+		cprintf("Kernel Heap placement strategy is NEXT FIT\n");
+	else
+		cprintf("Kernel Heap placement strategy is UNDEFINED\n");
+
+	return 0;
+}
+
+int command_disable_kheap_buddy(int number_of_arguments, char **arguments)
+{
+	if (enableKHeapBuddy(0) != 0)
+		cprintf("Kernel Heap is in use, the mode can't be changed\n");
+	else
+		cprintf("Kernel Heap buddy mode is now DISABLED\n");
+	return 0;
+}
+
+int command_enable_kheap_buddy(int number_of_arguments, char **arguments)
+{
+	if (enableKHeapBuddy(1) != 0)
+		cprintf("Kernel Heap is in use, the mode can't be changed\n");
+	else
+		cprintf("Kernel Heap buddy mode is now ENABLED\n");
+	return 0;
+}
+
 /*2015*///END======================================================
 
 int command_disable_modified_buffer(int number_of_arguments, char **arguments)
@@ -761,6 +956,8 @@ int command_disable_modified_buffer(int number_of_arguments, char **arguments)
 	}
 	else
 	{
+		//the pages of the modified buffer are written, they stay buffered as clean pages
+		flush_modified_buffer();
 		enableModifiedBuffer(0);
 		cprintf("Modified Buffer is now DISABLED\n");
 	}
@@ -786,6 +983,9 @@ int command_enable_modified_buffer(int number_of_arguments, char **arguments)
 
 int command_disable_buffering(int number_of_arguments, char **arguments)
 {
+	//the buffered pages give their frames back, the next fault of a page reads it again
+	if(isBufferingEnabled())
+		release_buffered_frames();
 	enableBuffering(0);
 	enableModifiedBuffer(0);
 	cprintf("Buffering is now DISABLED\n");
@@ -838,6 +1038,46 @@ int command_get_modified_buffer_length(int number_of_arguments, char **arguments
 	return 0;
 }
 
+int command_disable_zero_page_sharing(int number_of_arguments, char **arguments)
+{
+	enableZeroPageSharing(0);
+	cprintf("Zero page sharing is now DISABLED\n");
+	return 0;
+}
+
+int command_enable_zero_page_sharing(int number_of_arguments, char **arguments)
+{
+	enableZeroPageSharing(1);
+	cprintf("Zero page sharing is now ENABLED\n");
+	return 0;
+}
+
+int command_disable_uheap_tracing(int number_of_arguments, char **arguments)
+{
+	enableUHeapTracing(0);
+	cprintf("User heap tracing is now DISABLED\n");
+	return 0;
+}
+
+int command_enable_uheap_tracing(int number_of_arguments, char **arguments)
+{
+	enableUHeapTracing(1);
+	cprintf("User heap tracing is now ENABLED\n");
+	return 0;
+}
+
+int command_uheap_stats(int number_of_arguments, char **arguments)
+{
+	if (number_of_arguments < 2)
+	{
+		uheap_trace_list();
+		return 0;
+	}
+	if (!uheap_trace_print(strtol(arguments[1], NULL, 10)))
+		cprintf("No user heap trace for env %s\n", arguments[1]);
+	return 0;
+}
+
 int command_test_kmalloc(int number_of_arguments, char **arguments)
 {
 	test_kmalloc();
@@ -863,5 +1103,61 @@ int command_test_three_creation_functions(int number_of_arguments, char **argume
 	test_three_creation_functions();
 	return 0;
 }
+int command_test_kheap_virt_addr_time(int number_of_arguments, char **arguments)
+{
+	test_kheap_virt_addr_time();
+	return 0;
+}
+int command_test_kheap_placement(int number_of_arguments, char **arguments)
+{
+	test_kheap_placement();
+	return 0;
+}
+int command_test_kmem_cache(int number_of_arguments, char **arguments)
+{
+	test_kmem_cache();
+	return 0;
+}
+int command_test_kmalloc_small(int number_of_arguments, char **arguments)
+{
+	test_kmalloc_small();
+	return 0;
+}
+
+int command_test_kheap_buddy(int number_of_arguments, char **arguments)
+{
+	test_kheap_buddy();
+	return 0;
+}
+
+int command_test_kmalloc_map_time(int number_of_arguments, char **arguments)
+{
+	test_kmalloc_map_time();
+	return 0;
+}
+
+int command_test_krealloc(int number_of_arguments, char **arguments)
+{
+	test_krealloc();
+	return 0;
+}
+
+int command_test_kmalloc_reserve(int number_of_arguments, char **arguments)
+{
+	test_kmalloc_reserve();
+	return 0;
+}
+
+int command_test_zeroed_frames(int number_of_arguments, char **arguments)
+{
+	test_zeroed_frames();
+	return 0;
+}
+
+int command_test_allocate_frames(int number_of_arguments, char **arguments)
+{
+	test_allocate_frames();
+	return 0;
+}
 
 //END======================================================
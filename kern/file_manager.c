@@ -22,6 +22,7 @@ FUNCTIONS:	to_physical_address, get_frame_info, tlb_invalidate
 #include <kern/file_manager.h>
 #include <kern/memory_manager.h>
 #include <kern/kheap.h>
+#include <kern/kmem_cache.h>
 
 int pf_add_env_page(struct Env* ptr_env, uint32 virtual_address, void* ptrDataSrc);
 int __pf_write_env_table( struct Env* ptr_env, uint32 virtual_address, uint32* tableKVirtualAddress);
@@ -42,6 +43,16 @@ int read_disk_page(uint32 dfn, void* va)
 }
 
 
+//read the given number of pages from consecutive disk frames by one multi-sector transfer
+int read_disk_pages(uint32 dfn, void* va, uint32 pagesNumber)
+{
+	assert(pagesNumber > 0 && pagesNumber <= PAGES_PER_DISK_TRANSFER);
+	uint32 df_start_sector = PAGE_FILE_START_SECTOR+dfn*SECTOR_PER_PAGE;
+
+	return ide_read(df_start_sector, va, pagesNumber*SECTOR_PER_PAGE);
+}
+
+
 int write_disk_page(uint32 dfn, void* va)
 {
 	//write disk at wanted frame
@@ -62,10 +73,13 @@ uint32* ptr_disk_page_directory;
 
 struct Frame_Info* disk_frames_info;
 struct Linked_List disk_free_frame_list;
+//free disk frames promised to the zero-fill regions of the environments
+uint32 pf_reserved_frames = 0;
 
 void initialize_disk_page_file();
 
 int read_disk_page(uint32 dfn, void* va);
+int read_disk_pages(uint32 dfn, void* va, uint32 pagesNumber);
 int write_disk_page(uint32 dfn, void* va);
 
 int get_disk_page_directory(struct Env* ptr_env, uint32** ptr_disk_page_directory);
@@ -90,7 +104,9 @@ void initialize_disk_page_file()
 	LIST_INIT(&disk_free_frame_list);
 
 	//LOG_STATMENT(cprintf("PAGES_PER_FILE = %d, PAGE_FILE_START_SECTOR = %d\n",PAGES_PER_FILE,PAGE_FILE_START_SECTOR););
-	for (i = 1; i < PAGES_PER_FILE; i++)
+	//insert in reverse order, so that allocate_disk_frame() returns ascending frames and the
+	//consecutive pages take consecutive frames (they're read by one transfer)
+	for (i = PAGES_PER_FILE - 1; i >= 1; i--)
 	{
 		initialize_frame_info(&(disk_frames_info[i]));
 
@@ -123,7 +139,8 @@ int allocate_disk_frame(uint32 *dfn)
 {
 	// Fill this function in
 	struct Frame_Info *ptr_frame_info = LIST_FIRST(&disk_free_frame_list);
-	if(ptr_frame_info == NULL)
+	//the reserved frames are left for the pages of the zero-fill regions
+	if(ptr_frame_info == NULL || LIST_SIZE(&disk_free_frame_list) <= pf_reserved_frames)
 		return E_NO_PAGE_FILE_SPACE;
 
 	LIST_REMOVE(&disk_free_frame_list, ptr_frame_info);
@@ -142,6 +159,23 @@ inline void free_disk_frame(uint32 dfn)
 	LIST_INSERT_HEAD(&disk_free_frame_list, &disk_frames_info[dfn]);
 }
 
+//
+// Reserve disk frames for pages that take their frames later (at their first eviction),
+// the reserved frames are not given to allocate_disk_frame() until they are unreserved.
+//
+int pf_reserve_frames(uint32 n)
+{
+	if(LIST_SIZE(&disk_free_frame_list) < pf_reserved_frames + n)
+		return E_NO_PAGE_FILE_SPACE;
+	pf_reserved_frames += n;
+	return 0;
+}
+
+void pf_unreserve_frames(uint32 n)
+{
+	pf_reserved_frames -= n;
+}
+
 int get_disk_page_table(uint32 *ptr_disk_page_directory, const void *virtual_address, int create, uint32 **ptr_disk_page_table)
 {
 	// Fill this function in
@@ -164,7 +198,8 @@ int get_disk_page_table(uint32 *ptr_disk_page_directory, const void *virtual_add
 
 			if(USE_KHEAP)
 			{
-				*ptr_disk_page_table = (uint32*)kmalloc(PAGE_SIZE);
+				//the disk table cache hands out zeroed tables
+				*ptr_disk_page_table = (uint32*)kmem_cache_alloc(disk_table_cache);
 				if(*ptr_disk_page_table == NULL)
 				{
 					return E_NO_VM;
@@ -175,8 +210,9 @@ int get_disk_page_table(uint32 *ptr_disk_page_directory, const void *virtual_add
 			}
 			else
 			{
+				//the new page table is initialized by 0's
 				struct Frame_Info* ptr_frame_info;
-				allocate_frame(&ptr_frame_info) ;
+				allocate_zeroed_frame(&ptr_frame_info) ;
 
 				//LOG_STATMENT(cprintf("created table"));
 				uint32 phys_page_table = to_physical_address(ptr_frame_info);
@@ -184,8 +220,6 @@ int get_disk_page_table(uint32 *ptr_disk_page_directory, const void *virtual_add
 				ptr_frame_info->references = 1;
 				ptr_disk_page_directory[PDX(virtual_address)] = CONSTRUCT_ENTRY(phys_page_table,PERM_PRESENT);
 			}
-			//initialize new page table by 0's
-			memset(*ptr_disk_page_table , 0, PAGE_SIZE);
 
 			//LOG_STATMENT(cprintf("get_disk_page_table: disk directory entry # %d (VA = %x) is %x ",PDX(virtual_address),
 			//virtual_address, ptr_disk_page_directory[PDX(virtual_address)]));
@@ -225,6 +259,18 @@ int pf_add_empty_env_page( struct Env* ptr_env, uint32 virtual_address, uint8 in
 
 }
 
+//create the disk page tables of the given range without adding its pages
+void pf_add_env_page_tables(struct Env* ptr_env, uint32 virtual_address, uint32 size)
+{
+	uint32 *ptr_disk_page_table;
+	uint32 va;
+
+	get_disk_page_directory(ptr_env, &(ptr_env->disk_env_pgdir)) ;
+
+	for(va = ROUNDDOWN(virtual_address, PAGE_SIZE * 1024); va < virtual_address + size; va += PAGE_SIZE * 1024)
+		get_disk_page_table(ptr_env->disk_env_pgdir, (void*) va, 1, &ptr_disk_page_table) ;
+}
+
 int pf_add_env_page( struct Env* ptr_env, uint32 virtual_address, void* dataSrc)
 {
 	//LOG_STRING("========================== create_env_page");
@@ -314,6 +360,19 @@ int pf_special_update_env_modified_page(struct Env* ptr_env, uint32 virtual_addr
 	return write_disk_page(dfn, STATIC_KERNEL_VIRTUAL_ADDRESS(to_physical_address(page_modified_frame_info)));
 }
 */
+//returns 1 if the page of the given virtual address is in the page file
+int pf_env_page_exists(struct Env* ptr_env, uint32 virtual_address)
+{
+	uint32 *ptr_disk_page_table;
+
+	if( ptr_env->disk_env_pgdir == 0) return 0;
+
+	get_disk_page_table(ptr_env->disk_env_pgdir, (void*) virtual_address, 0, &ptr_disk_page_table);
+	if(ptr_disk_page_table == 0) return 0;
+
+	return ptr_disk_page_table[PTX(virtual_address)] != 0;
+}
+
 int pf_read_env_page(struct Env* ptr_env, void *virtual_address)
 {
 	uint32 *ptr_disk_page_table;
@@ -331,6 +390,8 @@ int pf_read_env_page(struct Env* ptr_env, void *virtual_address)
 	if( dfn == 0) return E_PAGE_NOT_EXIST_IN_PF;
 
 	int disk_read_error = read_disk_page(dfn, virtual_address);
+	ptr_env->pageFileReadsCounter++;
+	ptr_env->pageFileTransfersCounter++;
 
 	//reset modified bit to 0: because FOS copies the placed or replaced page from
 	//HD to memory, the page modified bit is set to 1, but we want the modified bit to be
@@ -340,6 +401,67 @@ int pf_read_env_page(struct Env* ptr_env, void *virtual_address)
 	return disk_read_error;
 }
 
+//read the given consecutive pages of the env from the page file (the pages must be mapped),
+//the pages on consecutive disk frames are read together by one multi-sector transfer
+int pf_read_env_pages(struct Env* ptr_env, uint32 virtual_address, uint32 pagesNumber)
+{
+	virtual_address = ROUNDDOWN(virtual_address, PAGE_SIZE);
+
+	if( ptr_env->disk_env_pgdir == 0) return E_PAGE_NOT_EXIST_IN_PF;
+
+	uint32 i = 0;
+	while(i < pagesNumber)
+	{
+		uint32 va = virtual_address + i*PAGE_SIZE;
+		uint32 *ptr_disk_page_table;
+		get_disk_page_table(ptr_env->disk_env_pgdir, (void*)va, 0, &ptr_disk_page_table);
+		if(ptr_disk_page_table == 0) return E_PAGE_NOT_EXIST_IN_PF;
+
+		uint32 dfn=ptr_disk_page_table[PTX(va)];
+		if( dfn == 0) return E_PAGE_NOT_EXIST_IN_PF;
+
+		//the next pages of the same disk table on the next disk frames
+		uint32 n = 1;
+		while(i + n < pagesNumber && n < PAGES_PER_DISK_TRANSFER && PTX(va) + n < NPTENTRIES
+				&& ptr_disk_page_table[PTX(va) + n] == dfn + n)
+			n++;
+
+		int disk_read_error = read_disk_pages(dfn, (void*)va, n);
+		if(disk_read_error != 0) return disk_read_error;
+		ptr_env->pageFileReadsCounter += n;
+		ptr_env->pageFileTransfersCounter++;
+		i += n;
+	}
+
+	//reset modified bit to 0 (see pf_read_env_page())
+	for(i = 0; i < pagesNumber; i++)
+		pt_set_page_permissions(ptr_env, virtual_address + i*PAGE_SIZE, 0, PERM_MODIFIED);
+
+	return 0;
+}
+
+//move the page file entry of a page to another page of the same env without copying the page,
+//the old page of the destination (if any) is removed from the page file
+void pf_move_env_page(struct Env* ptr_env, uint32 src_virtual_address, uint32 dst_virtual_address)
+{
+	uint32 *ptr_src_disk_page_table, *ptr_dst_disk_page_table;
+
+	if( ptr_env->disk_env_pgdir == 0) return;
+
+	get_disk_page_table(ptr_env->disk_env_pgdir, (void*)src_virtual_address, 0, &ptr_src_disk_page_table);
+	uint32 dfn = (ptr_src_disk_page_table == 0) ? 0 : ptr_src_disk_page_table[PTX(src_virtual_address)];
+	if( dfn == 0)
+	{
+		pf_remove_env_page(ptr_env, dst_virtual_address);
+		return;
+	}
+
+	get_disk_page_table(ptr_env->disk_env_pgdir, (void*)dst_virtual_address, 1, &ptr_dst_disk_page_table);
+	free_disk_frame(ptr_dst_disk_page_table[PTX(dst_virtual_address)]);
+	ptr_dst_disk_page_table[PTX(dst_virtual_address)] = dfn;
+	ptr_src_disk_page_table[PTX(src_virtual_address)] = 0;
+}
+
 void pf_remove_env_page(struct Env* ptr_env, uint32 virtual_address)
 {
 	//LOG_STRING("pf_remove_env_page: 0");
@@ -359,6 +481,74 @@ void pf_remove_env_page(struct Env* ptr_env, uint32 virtual_address)
 	//LOG_STRING("pf_remove_env_page: 3");
 }
 
+//remove the pages of the given range from the page file, visiting each disk page table once
+//(the tables of the 4 MB spans covered by the range are removed), returns the number of removed pages
+uint32 pf_remove_env_page_range(struct Env* ptr_env, uint32 virtual_address, uint32 size)
+{
+	uint32 *ptr_disk_page_table;
+	uint32 removed = 0;
+
+	if( ptr_env->disk_env_pgdir == 0) return 0;
+
+	uint32 va = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	uint32 end = ROUNDUP(virtual_address + size, PAGE_SIZE);
+	while (va < end)
+	{
+		//the pages of the range in the current disk page table
+		uint32 n = NPTENTRIES - PTX(va);
+		if ((end - va) / PAGE_SIZE < n)
+			n = (end - va) / PAGE_SIZE;
+
+		if (ptr_env->disk_env_pgdir[PDX(va)] != 0)
+		{
+			get_disk_page_table(ptr_env->disk_env_pgdir, (void*) va, 0, &ptr_disk_page_table);
+			//the frames are freed backwards, so they're allocated again in ascending order
+			int pteno;
+			for (pteno = PTX(va) + n - 1; pteno >= (int) PTX(va); pteno--)
+			{
+				uint32 dfn = ptr_disk_page_table[pteno];
+				if (dfn == 0) continue;
+				ptr_disk_page_table[pteno] = 0;
+				free_disk_frame(dfn);
+				removed++;
+			}
+			//the range covers the whole 4 MB span, so its disk table has no pages left
+			if (n == NPTENTRIES)
+				pf_remove_env_page_table(ptr_env, va);
+		}
+		va += n * PAGE_SIZE;
+	}
+	return removed;
+}
+
+//remove the disk page table of the 4 MB span of the given address if it has no pages,
+//returns 1 if the table is removed
+int pf_remove_env_page_table(struct Env* ptr_env, uint32 virtual_address)
+{
+	uint32 *ptr_disk_page_table;
+
+	if( ptr_env->disk_env_pgdir == 0) return 0;
+	uint32 pa = EXTRACT_ADDRESS(ptr_env->disk_env_pgdir[PDX(virtual_address)]);
+	if( pa == 0) return 0;
+
+	get_disk_page_table(ptr_env->disk_env_pgdir, (void*) virtual_address, 0, &ptr_disk_page_table);
+	uint32 pteno;
+	for (pteno = 0; pteno < NPTENTRIES; pteno++)
+		if (ptr_disk_page_table[pteno] != 0)
+			return 0;
+
+	ptr_env->disk_env_pgdir[PDX(virtual_address)] = 0;
+	if(USE_KHEAP)
+	{
+		kfree(ptr_disk_page_table);
+	}
+	else
+	{
+		decrement_references(to_frame_info(pa));
+	}
+	return 1;
+}
+
 void pf_free_env(struct Env* ptr_env)
 {
 	uint32 pdeno;
@@ -380,9 +570,9 @@ void pf_free_env(struct Env* ptr_env)
 		{
 			pt = (uint32*) STATIC_KERNEL_VIRTUAL_ADDRESS(pa);
 		}
-		// unmap all PTEs in this page table
-		uint32 pteno;
-		for (pteno = 0; pteno < 1024; pteno++)
+		// unmap all PTEs in this page table (backwards, so the frames are allocated again in ascending order)
+		int pteno;
+		for (pteno = 1023; pteno >= 0; pteno--)
 		{
 			// remove the disk page from disk page table
 			uint32 dfn=pt[pteno];
@@ -444,7 +634,7 @@ int get_disk_page_directory(struct Env* ptr_env, uint32** ptr_disk_page_director
 		//	LOG_STATMENT(cprintf(">>>>>>>>>>>>>> disk directory not found, creating one ...\n"););
 		if(USE_KHEAP)
 		{
-			*ptr_disk_page_directory = kmalloc(PAGE_SIZE);
+			*ptr_disk_page_directory = kmem_cache_alloc(disk_table_cache);
 			if(*ptr_disk_page_directory == NULL)
 			{
 				return E_NO_VM;
@@ -456,7 +646,8 @@ int get_disk_page_directory(struct Env* ptr_env, uint32** ptr_disk_page_director
 			int r;
 			struct Frame_Info *p = NULL;
 
-			if ((r = allocate_frame(&p)) < 0)
+			//the new directory is initialized by 0's
+			if ((r = allocate_zeroed_frame(&p)) < 0)
 				return r;
 			p->references = 1;
 
@@ -466,8 +657,6 @@ int get_disk_page_directory(struct Env* ptr_env, uint32** ptr_disk_page_director
 			ptr_env->disk_env_pgdir_PA = to_physical_address(p);
 		}
 
-		memset(*ptr_disk_page_directory , 0, PAGE_SIZE);
-
 		//	LOG_STATMENT(cprintf(">>>>>>>>>>>>>> Disk directory created at %x", *ptr_disk_page_directory));
 	}
 	return 0;
@@ -509,7 +698,8 @@ int pf_calculate_allocated_pages(struct Env* ptr_env)
 		}
 	}
 
-	return counter;
+	//the pages of the zero-fill regions have their frames reserved
+	return counter + ptr_env->anon_reserved_pages;
 }
 
 //2016:
@@ -523,7 +713,7 @@ int pf_calculate_free_frames()
 	{
 		totalFreeDiskFrames++ ;
 	}
-	return totalFreeDiskFrames;
+	return totalFreeDiskFrames - pf_reserved_frames;
 }
 ///========================== END OF PAGE FILE MANAGMENT =============================
 
@@ -538,7 +728,7 @@ int get_disk_table_directory(struct Env* ptr_env, uint32** ptr_disk_table_direct
 		//	LOG_STATMENT(cprintf(">>>>>>>>>>>>>> disk directory not found, creating one ...\n"););
 		if(USE_KHEAP)
 		{
-			*ptr_disk_table_directory = kmalloc(PAGE_SIZE);
+			*ptr_disk_table_directory = kmem_cache_alloc(disk_table_cache);
 			if(*ptr_disk_table_directory == NULL)
 			{
 				return E_NO_VM;
@@ -550,7 +740,8 @@ int get_disk_table_directory(struct Env* ptr_env, uint32** ptr_disk_table_direct
 			int r;
 			struct Frame_Info *p = NULL;
 
-			if ((r = allocate_frame(&p)) < 0)
+			//the new directory is initialized by 0's
+			if ((r = allocate_zeroed_frame(&p)) < 0)
 				return r;
 			p->references = 1;
 
@@ -560,8 +751,6 @@ int get_disk_table_directory(struct Env* ptr_env, uint32** ptr_disk_table_direct
 			ptr_env->disk_env_tabledir_PA = to_physical_address(p);
 		}
 
-		memset(*ptr_disk_table_directory , 0, PAGE_SIZE);
-
 		//	LOG_STATMENT(cprintf(">>>>>>>>>>>>>> Disk directory created at %x", *ptr_disk_page_directory));
 	}
 	return 0;
@@ -9,6 +9,7 @@
 #define SECTOR_SIZE 512
 #define PAGE_FILE_START_SECTOR ( (20<<20) /SECTOR_SIZE)  //start sector number of Page file in H.D.
 #define SECTOR_PER_PAGE (PAGE_SIZE/SECTOR_SIZE)
+#define PAGES_PER_DISK_TRANSFER (256/SECTOR_PER_PAGE)	//pages of one multi-sector transfer (256 sectors at most)
 
 #define PAGE_FILE_SIZE (520 << 20)   	//page file size in MB
 #define PAGES_PER_FILE (PAGE_FILE_SIZE/PAGE_SIZE)
@@ -16,13 +17,21 @@
 ///=============================================================================================
 
 int pf_add_empty_env_page( struct Env* ptr_env, uint32 virtual_address, uint8 initializeByZero);
+void pf_add_env_page_tables(struct Env* ptr_env, uint32 virtual_address, uint32 size);
 int pf_update_env_page(struct Env* ptr_env, void *virtual_address, struct Frame_Info* modified_page_frame_info);
 //int pf_special_update_env_modified_page(struct Env* ptr_env, uint32 virtual_address, struct Frame_Info* page_modified_frame_info);
 int pf_read_env_page(struct Env* ptr_env, void *virtual_address);
+int pf_read_env_pages(struct Env* ptr_env, uint32 virtual_address, uint32 pagesNumber);
+int pf_env_page_exists(struct Env* ptr_env, uint32 virtual_address);
 void pf_remove_env_page(struct Env* ptr_env, uint32 virtual_address);
+uint32 pf_remove_env_page_range(struct Env* ptr_env, uint32 virtual_address, uint32 size);
+int pf_remove_env_page_table(struct Env* ptr_env, uint32 virtual_address);
+void pf_move_env_page(struct Env* ptr_env, uint32 src_virtual_address, uint32 dst_virtual_address);
 
 ///=============================================================================================
 
+int pf_reserve_frames(uint32 n);
+void pf_unreserve_frames(uint32 n);
 int pf_calculate_allocated_pages(struct Env* ptr_env);
 void pf_free_env(struct Env* ptr_env);
 
@@ -13,6 +13,9 @@
 #include <kern/trap.h>
 #include <kern/picirq.h>
 #include <kern/sched.h>
+#include <kern/kheap.h>
+#include <kern/kmem_cache.h>
+#include <kern/uheap_trace.h>
 
 //Functions Declaration
 //======================
@@ -45,6 +48,10 @@ void FOS_initialize()
 	detect_memory();
 	initialize_kernel_VM();
 	initialize_paging();
+	initialize_kheap();
+	//enableKHeapBuddy(1);
+	enableKHeapBuddy(0);
+	initialize_kmem_caches();
 //	page_check();
 
 
@@ -53,9 +60,12 @@ void FOS_initialize()
 	idt_init();
 	setPageReplacmentAlgorithmLRU();
 	setUHeapPlacementStrategyFIRSTFIT();
+	setKHeapPlacementStrategyCONTINUOUS();
 	enableBuffering(0);
 	//enableModifiedBuffer(1) ;
 	enableModifiedBuffer(0) ;
+	enableZeroPageSharing(0);
+	enableUHeapTracing(0);
 
 	// Lab 4 multitasking initialization functions
 	pic_init();
@@ -79,6 +89,8 @@ void FOS_initialize()
 	{
 		cprintf("\nWelcome to the FOS kernel command prompt!\n");
 		cprintf("Type 'help' for a list of commands.\n");
+		//nothing to run, zero free frames for the coming page tables and pages
+		refill_zeroed_frames(ZEROED_FRAMES_TARGET);
 		run_command_prompt();
 	}
 }
@@ -1,22 +1,84 @@
 #include <inc/memlayout.h>
+#include <inc/string.h>
 #include <kern/kheap.h>
 #include <kern/memory_manager.h>
+#include <kern/kmem_cache.h>
 
 //my helper global variables
-uint32 kernelInside = KERNEL_HEAP_START;
-int nextBlock = 0;
-
-//my helper global structure
-struct keep{
-	//keep track with the blocks info.
-	uint32* blockStartVirtualAddress;
-	uint32 blockSize;
+uint32 kernelInside = KERNEL_HEAP_START;	//the break of the CONTINUOUS allocation
+uint32 nextFitPage = 0;				//where the next NEXT FIT search starts
+uint32 extentSeed = 1;
+uint32 kheapUsedPages = 0;			//pages reserved by the allocated blocks
+uint32 kheapLazyPages = 0;			//pages of reserved (lazy) blocks that are not mapped yet
+
+//my helper global structures
+//The free extents of the kernel heap are kept in two treaps sharing the same nodes:
+//the ADDRESS tree is ordered by start page and keeps the largest extent of each
+//subtree (used by FIRST FIT, NEXT FIT and coalescing), the SIZE tree is ordered by
+//(pages, start page) (used by BEST FIT). Pages are counted from KERNEL_HEAP_START.
+#define ADDRESS_TREE 0
+#define SIZE_TREE 1
+
+//two free extents are always separated by an allocated page
+#define MAX_FREE_EXTENTS (KHEAP_PAGES / 2 + 2)
+
+struct freeExtent{
+	uint16 start, pages;
+	uint16 maxPages;		//largest extent in the ADDRESS subtree
+	uint16 priority;
+	uint16 left[2], right[2];	//children in each tree (node 0 is the empty tree)
 };
 
 //my helper global arrays
-struct keep keepBlocks[512];
-
-//2016: NOTE: All kernel heap allocations are multiples of PAGE_SIZE (4KB)
+struct kheapBlock kheapBlocks[KHEAP_PAGES];
+struct kheapCaller kheapCallers[MAX_KHEAP_CALLERS];
+int numOfKheapCallers = 1;
+struct freeExtent freeExtents[MAX_FREE_EXTENTS];
+uint16 extentRoot[2];
+uint16 unusedExtents;			//unused nodes, linked through left[ADDRESS_TREE]
+
+//The free blocks of the buddy mode: one doubly linked list per order, linked through
+//the first page of each free block. buddyFreeOrder[page] is (order + 1) of the free
+//block starting at that page, 0 if no free block starts there.
+uint16 buddyFreeLists[BUDDY_MAX_ORDER + 1];
+uint8 buddyFreeOrder[KHEAP_PAGES];
+uint16 buddyNext[KHEAP_PAGES], buddyPrev[KHEAP_PAGES];
+
+//2016: NOTE: Kernel heap allocations are multiples of PAGE_SIZE (4KB), except the small
+//ones (up to KMALLOC_MAX_SMALL bytes) which are carved from the pages of the kmalloc caches
+
+void initialize_kheap()
+{
+	int n;
+	//all nodes are unused except node 1 which holds the whole heap
+	unusedExtents = 0;
+	for(n = MAX_FREE_EXTENTS - 1; n > 1; n--){
+		freeExtents[n].left[ADDRESS_TREE] = unusedExtents;
+		unusedExtents = n;
+	}
+	extentRoot[ADDRESS_TREE] = extentRoot[SIZE_TREE] = 0;
+
+	n = extentNew(0, KHEAP_PAGES);
+	extentInsert(n);
+
+	kernelInside = KERNEL_HEAP_START;
+	nextFitPage = 0;
+	kheapUsedPages = 0;
+	kheapLazyPages = 0;
+
+	//the buddy mode starts with the largest aligned blocks covering the whole heap
+	int order;
+	for(order = 0; order <= BUDDY_MAX_ORDER; order++) buddyFreeLists[order] = BUDDY_NONE;
+	memset(buddyFreeOrder, 0, sizeof(buddyFreeOrder));
+
+	uint32 page = 0;
+	while(page < KHEAP_PAGES){
+		order = BUDDY_MAX_ORDER;
+		while(page % (1 << order) != 0 || page + (1 << order) > KHEAP_PAGES) order--;
+		buddyPush(page, order);
+		page += 1 << order;
+	}
+}
 
 void* kmalloc(unsigned int size)
 {
@@ -24,42 +86,78 @@ void* kmalloc(unsigned int size)
 	// Write your code here, remove the panic and write your code
 	//panic("kmalloc() is not implemented yet...!!");
 
-	//NOTE: Allocation is continuous increasing virtual address
 	//NOTE: All kernel heap allocations are multiples of PAGE_SIZE (4KB)
 	//refer to the project documentation for the detailed steps
 
+	return kmalloc_caller(size, 0, (uint32) __builtin_return_address(0));
+}
+
+//like kmalloc() but the block is zeroed, its pages get frames of the zeroed frames pool
+void* kmalloc_zeroed(unsigned int size)
+{
+	return kmalloc_caller(size, 1, (uint32) __builtin_return_address(0));
+}
+
+//kmalloc() charged to the given caller in kheapCallers (the caches allocate on
+//behalf of their own callers)
+void* kmalloc_caller(unsigned int size, int zeroed, uint32 eip)
+{
 	//check the size
-	if(size >= KERNEL_HEAP_MAX - kernelInside) return NULL;
-	//--------------why not !-------------------------------
-	//if(kernelInside + size >= KERNEL_HEAP_MAX) return NULL;
+	if(size == 0 || size > KERNEL_HEAP_MAX - KERNEL_HEAP_START) return NULL;
+
+	//small requests share the pages of their size class, they are zeroed in place
+	if(size <= KMALLOC_MAX_SMALL){
+		struct kmem_cache* sizeClass = kmalloc_size_class(size);
+		if(sizeClass != NULL){
+			void* object = kmem_cache_alloc_caller(sizeClass, eip);
+			if(zeroed && object != NULL) memset(object, 0, size);
+			return object;
+		}
+	}
+
+	return kheapMapBlock(ROUNDUP(size, PAGE_SIZE) / PAGE_SIZE, zeroed, eip);
+}
+
+//reserve a block of the given pages and map a frame at each page (zeroed frames if asked)
+void* kheapMapBlock(uint32 pages, int zeroed, uint32 eip)
+{
+	//TODO: [PROJECT 2016 - BONUS1] Implement a Kernel allocation strategy
+	//find a free extent according to the kernel heap placement strategy (or a buddy block)
+	int page = kheapReserve(pages);
+	if(page < 0) return NULL;
 
 	//good!, let's begin
-	//uint32 endVA = ROUNDUP((uint32) kernelInside + size, PAGE_SIZE);
-	uint32 va;
-	for(va = kernelInside; va < kernelInside + size; va += PAGE_SIZE){
-		//(1) allocate a free frame
-		struct Frame_Info* frameInfo = NULL;
-		if(allocate_frame(&frameInfo) == E_NO_MEM) return NULL;
-
-		//(2) map the page to the allocated frame
-		if(map_frame(ptr_page_directory, frameInfo, (void*) va,
-				PERM_WRITEABLE | PERM_PRESENT) == E_NO_MEM)
-			return NULL;
+	//allocate a free frame for each page and map them, one page table walk per 4 MB
+	//(each frame remembers where it is mapped for kheap_virtual_address)
+	uint32 startVA = kheapPageAddress(page);
+	if(__map_frame_range(ptr_page_directory, startVA, pages * PAGE_SIZE, 0, PERM_WRITEABLE | PERM_PRESENT, zeroed) == E_NO_MEM){
+		kheapRelease(page, pages);
+		return NULL;
 	}
 
-	//keep the block in my keepBlock array
-	keepBlocks[nextBlock].blockStartVirtualAddress = (uint32*) kernelInside;
-	keepBlocks[nextBlock++].blockSize = size;
+	//keep the block size at its first page
+	kheapBlocks[page].pages = pages;
+	kheapTrackCaller(page, eip);
 
-	//TODO: [PROJECT 2016 - BONUS1] Implement a Kernel allocation strategy
-	// Instead of the continuous allocation/deallocation, implement one of
-	// the strategies NEXT FIT, BEST FIT, .. etc
+	return (void*) startVA;
+}
 
+//reserve the pages of a block without mapping them, each page gets a zeroed frame
+//on its first access (see kheap_fault_handler)
+void* kmalloc_reserve(unsigned int size)
+{
+	if(size == 0 || size > KERNEL_HEAP_MAX - KERNEL_HEAP_START) return NULL;
 
-	//change this "return" according to your answer
-	//uint32 ret = kernelInside;
-	kernelInside = va;
-	return (void*) keepBlocks[nextBlock - 1].blockStartVirtualAddress;
+	uint32 pages = ROUNDUP(size, PAGE_SIZE) / PAGE_SIZE;
+	int page = kheapReserve(pages);
+	if(page < 0) return NULL;
+
+	kheapSetLazy(page, pages, 1);
+	kheapLazyPages += pages;
+	kheapBlocks[page].pages = pages;
+	kheapTrackCaller(page, (uint32) __builtin_return_address(0));
+
+	return (void*) kheapPageAddress(page);
 }
 
 void kfree(void* virtual_address)
@@ -74,36 +172,127 @@ void kfree(void* virtual_address)
 	//validate the virtual address
 	if((uint32) virtual_address < KERNEL_HEAP_START || (uint32) virtual_address >= KERNEL_HEAP_MAX) return;
 
-	//check the given virtual address
-	uint32* pageTable = NULL;
-	struct Frame_Info* frameInfo = NULL;
-	frameInfo = get_frame_info(ptr_page_directory, virtual_address, &pageTable);
+	//small objects go back to the slab page holding them
+	uint32 page = kheapPageNumber(virtual_address);
+	if(kheapBlocks[page].cache != NULL && kheapBlocks[page].cache->object_size < PAGE_SIZE){
+		kmem_cache_free(kheapBlocks[page].cache, virtual_address);
+		return;
+	}
 
-	if(frameInfo == NULL) return;
+	//good!, then find the block starting at this address
+	if(kheapPageAddress(page) != (uint32) virtual_address || kheapBlocks[page].pages == 0) return;
 
+	//objects of a cache go back to their cache, still mapped
+	if(kheapBlocks[page].cache != NULL){
+		kmem_cache_free(kheapBlocks[page].cache, virtual_address);
+		return;
+	}
 
-	//good!, then searching about the block
-	int blockIndex = findBlock(virtual_address);
-	if(blockIndex == -1) return;
+	kheapUntrackCaller(page);
+	uint32 pages = kheapBlocks[page].pages;
+	kheapBlocks[page].pages = 0;
 
 	//now we can unmap this block, see it's easy
-	uint32 va;
-	for(va = (uint32) virtual_address; va < (uint32) virtual_address + keepBlocks[blockIndex].blockSize;
-			va += PAGE_SIZE)
-		//unmap block pages
-		unmap_frame(ptr_page_directory, (void*) va);
+	uint32 mapped = unmap_range(ptr_page_directory, (uint32) virtual_address, pages * PAGE_SIZE);
+	if(kheapBlocks[page].lazy){
+		kheapLazyPages -= pages - mapped;
+		kheapSetLazy(page, pages, 0);
+	}
+
+	//give the pages back to the free extents (coalesced with its neighbors)
+	kheapRelease(page, pages);
+}
 
-	//delete the unmaped block from the keepBlock array
-	int i;
-	for(i = blockIndex; i < nextBlock - 1; i++)
-		keepBlocks[i] = keepBlocks[i + 1];
+void* krealloc(void* virtual_address, uint32 new_size)
+{
+	uint32 caller = (uint32) __builtin_return_address(0);
+	if(virtual_address == NULL) return kmalloc_caller(new_size, 0, caller);
+	if(new_size == 0){
+		kfree(virtual_address);
+		return NULL;
+	}
 
-	nextBlock--;
+	//validate the size and the virtual address
+	if(new_size > KERNEL_HEAP_MAX - KERNEL_HEAP_START) return NULL;
+	if((uint32) virtual_address < KERNEL_HEAP_START || (uint32) virtual_address >= KERNEL_HEAP_MAX) return NULL;
+
+	//objects of a cache (small ones included) keep their size, move them only if they don't fit
+	uint32 page = kheapPageNumber(virtual_address);
+	struct kmem_cache* cache = kheapBlocks[page].cache;
+	if(cache != NULL){
+		if(new_size <= cache->object_size) return virtual_address;
+		void* ptr = kmalloc_caller(new_size, 0, caller);
+		if(ptr == NULL) return NULL;
+		memcpy(ptr, virtual_address, cache->object_size);
+		kfree(virtual_address);
+		return ptr;
+	}
 
-	//TODO: [PROJECT 2016 - BONUS1] Implement a Kernel allocation strategy
-	// Instead of the continuous allocation/deallocation, implement one of
-	// the strategies NEXT FIT, BEST FIT, .. etc
+	//good!, then find the block starting at this address
+	if(kheapPageAddress(page) != (uint32) virtual_address || kheapBlocks[page].pages == 0) return NULL;
+
+	uint32 oldPages = kheapBlocks[page].pages;
+	uint32 newPages = ROUNDUP(new_size, PAGE_SIZE) / PAGE_SIZE;
+	uint8 lazy = kheapBlocks[page].lazy;
+	if(newPages == oldPages) return virtual_address;
+
+	//shrink in place: unmap the tail frames and give the tail pages back
+	if(newPages < oldPages){
+		uint32 mapped = unmap_range(ptr_page_directory, kheapPageAddress(page + newPages), (oldPages - newPages) * PAGE_SIZE);
+		if(lazy){
+			kheapLazyPages -= (oldPages - newPages) - mapped;
+			kheapSetLazy(page + newPages, oldPages - newPages, 0);
+		}
+		kheapShrinkBlock(page, oldPages, newPages);
+		kheapUntrackCaller(page);
+		kheapBlocks[page].pages = newPages;
+		kheapTrackCaller(page, caller);
+		return virtual_address;
+	}
 
+	//grow in place if the pages after the block are free: only the new tail is mapped
+	//(or reserved for a lazy block)
+	uint32 tailVA = kheapPageAddress(page + oldPages);
+	if(kheapExtendBlock(page, oldPages, newPages)){
+		if(lazy){
+			kheapSetLazy(page + oldPages, newPages - oldPages, 1);
+			kheapLazyPages += newPages - oldPages;
+		}
+		else if(map_frame_range(ptr_page_directory, tailVA, (newPages - oldPages) * PAGE_SIZE, 0, PERM_WRITEABLE | PERM_PRESENT) == E_NO_MEM){
+			kheapShrinkBlock(page, newPages, oldPages);
+			return NULL;
+		}
+		kheapUntrackCaller(page);
+		kheapBlocks[page].pages = newPages;
+		kheapTrackCaller(page, caller);
+		return virtual_address;
+	}
+
+	//otherwise move the block: its frames are mapped at the new place (no copy)
+	//and only the new tail gets new frames
+	int newPage = kheapReserve(newPages);
+	if(newPage < 0) return NULL;
+	uint32 newVA = kheapPageAddress(newPage);
+	if(lazy){
+		//the pages that are not mapped yet stay reserved at the new place
+		kheapSetLazy(page, oldPages, 0);
+		kheapSetLazy(newPage, newPages, 1);
+		kheapLazyPages += newPages - oldPages;
+	}
+	else if(map_frame_range(ptr_page_directory, newVA + oldPages * PAGE_SIZE, (newPages - oldPages) * PAGE_SIZE, 0, PERM_WRITEABLE | PERM_PRESENT) == E_NO_MEM){
+		kheapRelease(newPage, newPages);
+		return NULL;
+	}
+	map_frame_range(ptr_page_directory, newVA, oldPages * PAGE_SIZE, (uint32) virtual_address, PERM_WRITEABLE | PERM_PRESENT);
+	unmap_range(ptr_page_directory, (uint32) virtual_address, oldPages * PAGE_SIZE);
+
+	kheapUntrackCaller(page);
+	kheapBlocks[page].pages = 0;
+	kheapRelease(page, oldPages);
+	kheapBlocks[newPage].pages = newPages;
+	kheapTrackCaller(newPage, caller);
+
+	return (void*) newVA;
 }
 
 unsigned int kheap_virtual_address(unsigned int physical_address)
@@ -115,20 +304,15 @@ unsigned int kheap_virtual_address(unsigned int physical_address)
 	//return the virtual address corresponding to given physical_address
 	//refer to the project documentation for the detailed steps
 
-	//sacn the whole kernel heap to find the mapped virtual address
-	uint32 va;
-	for(va = KERNEL_HEAP_START; va 	< (uint32) keepBlocks[nextBlock - 1].blockStartVirtualAddress
-	 + keepBlocks[nextBlock - 1].blockSize; va += PAGE_SIZE){
-		//use kheap_physical_address
-		uint32 framePhysicalAddress = kheap_physical_address(va);
-		if(framePhysicalAddress == physical_address)
-			return va;
-
-	}
+	//each kernel heap frame keeps the virtual address it is mapped at, so
+	//there is no need to scan the whole kernel heap
+	if(PPN(physical_address) >= number_of_frames) return 0;
 
+	struct Frame_Info* frameInfo = to_frame_info(physical_address);
+	if(frameInfo->kheap_va == 0) return 0;
 
 	//change this "return" according to your answer
-	return 0;
+	return frameInfo->kheap_va + PGOFF(physical_address);
 }
 
 unsigned int kheap_physical_address(unsigned int virtual_address)
@@ -150,11 +334,439 @@ unsigned int kheap_physical_address(unsigned int virtual_address)
 	return 0;
 }
 
-int findBlock(void* virtualAddress){
-	int index;
-	for(index = 0; index < nextBlock; index++)
-		if(keepBlocks[index].blockStartVirtualAddress == (uint32*) virtualAddress)
-			return index;
+//map a zeroed frame at a page of a reserved (lazy) block on its first access,
+//returns 0 if the page is not a reserved one
+int kheap_fault_handler(uint32 fault_va)
+{
+	if(fault_va < KERNEL_HEAP_START || fault_va >= KERNEL_HEAP_MAX) return 0;
+
+	uint32 page = kheapPageNumber(fault_va);
+	uint32 va = kheapPageAddress(page);
+	if(!kheapBlocks[page].lazy || kheap_physical_address(va) != 0) return 0;
+
+	if(map_zeroed_frame_range(ptr_page_directory, va, PAGE_SIZE, PERM_WRITEABLE | PERM_PRESENT) == E_NO_MEM) return 0;
+	kheapLazyPages--;
+	return 1;
+}
+
+void kheapSetLazy(uint32 page, uint32 pages, uint8 lazy){
+	uint32 p;
+	for(p = page; p < page + pages; p++) kheapBlocks[p].lazy = lazy;
+}
+
+void kheapSetCache(void* virtual_address, struct kmem_cache* cache){
+	kheapBlocks[kheapPageNumber(virtual_address)].cache = cache;
+}
+
+int kheapReserve(uint32 pages){
+	int page;
+	if(isKHeapBuddyEnabled()) page = buddyAlloc(pages);
+	else page = kheapPlaceBlock(pages);
 
-	return -1;
+	if(page >= 0) kheapUsedPages += pages;
+	return page;
+}
+
+void kheapRelease(uint32 page, uint32 pages){
+	kheapUsedPages -= pages;
+	if(isKHeapBuddyEnabled()) buddyFree(page, pages);
+	else extentRelease(page, pages);
+}
+
+//reserve the pages [page + oldPages, page + newPages) for the block at page, returns 0 if they are not free
+int kheapExtendBlock(uint32 page, uint32 oldPages, uint32 newPages){
+	if(isKHeapBuddyEnabled()){
+		//the block already holds the pages of its order, a larger order needs the free buddies above it
+		int order = buddyOrder(oldPages), newOrder = buddyOrder(newPages), o;
+		if(newOrder > BUDDY_MAX_ORDER || page % (1 << newOrder) != 0) return 0;
+		for(o = order; o < newOrder; o++)
+			if(page + (1 << o) >= KHEAP_PAGES || buddyFreeOrder[page + (1 << o)] != o + 1) return 0;
+		for(o = order; o < newOrder; o++)
+			buddyUnlink(page + (1 << o), o);
+	}
+	else{
+		uint32 end = page + oldPages;
+		int n = (end < KHEAP_PAGES) ? extentContaining(end) : 0;
+		if(n == 0 || freeExtents[n].start != end || extentEnd(n) < page + newPages) return 0;
+		extentCarve(n, end, newPages - oldPages);
+
+		//keep the CONTINUOUS break above the block
+		if(kernelInside >= kheapPageAddress(end) && kernelInside < kheapPageAddress(page + newPages))
+			kernelInside = kheapPageAddress(page + newPages);
+	}
+	kheapUsedPages += newPages - oldPages;
+	return 1;
+}
+
+//give the pages [page + newPages, page + oldPages) of the block at page back
+void kheapShrinkBlock(uint32 page, uint32 oldPages, uint32 newPages){
+	if(isKHeapBuddyEnabled()){
+		//the upper halves that are no longer needed become free blocks
+		int order = buddyOrder(oldPages), o;
+		for(o = buddyOrder(newPages); o < order; o++)
+			buddyPush(page + (1 << o), o);
+	}
+	else{
+		extentRelease(page + newPages, oldPages - newPages);
+
+		//the CONTINUOUS break follows the end of the block
+		if(kernelInside == kheapPageAddress(page + oldPages))
+			kernelInside = kheapPageAddress(page + newPages);
+	}
+	kheapUsedPages -= oldPages - newPages;
+}
+
+//add the block to the totals of its caller
+void kheapTrackCaller(uint32 page, uint32 eip){
+	int c;
+	for(c = 1; c < numOfKheapCallers && kheapCallers[c].eip != eip; c++);
+	if(c == numOfKheapCallers){
+		if(numOfKheapCallers < MAX_KHEAP_CALLERS) kheapCallers[numOfKheapCallers++].eip = eip;
+		else c = 0;
+	}
+	kheapCallers[c].blocks++;
+	kheapCallers[c].pages += kheapBlocks[page].pages;
+	kheapBlocks[page].caller = c;
+}
+
+void kheapUntrackCaller(uint32 page){
+	struct kheapCaller* caller = &kheapCallers[kheapBlocks[page].caller];
+	caller->blocks--;
+	caller->pages -= kheapBlocks[page].pages;
+}
+
+//the free pages of the kernel heap: number, extents, largest extent and size histogram
+void kheapGetFreeStats(struct kheapFreeStats* stats){
+	memset(stats, 0, sizeof(*stats));
+	if(isKHeapBuddyEnabled()){
+		int order;
+		uint32 page;
+		for(order = 0; order <= BUDDY_MAX_ORDER; order++)
+			for(page = buddyFreeLists[order]; page != BUDDY_NONE; page = buddyNext[page])
+				kheapCountFree(stats, 1 << order);
+	}
+	else kheapCountExtents(extentRoot[ADDRESS_TREE], stats);
+}
+
+void kheapCountFree(struct kheapFreeStats* stats, uint32 pages){
+	int bucket = 0;
+	while(bucket < KHEAP_HISTOGRAM_BUCKETS - 1 && (2 << bucket) <= pages) bucket++;
+	stats->histogram[bucket]++;
+	stats->freeExtents++;
+	stats->freePages += pages;
+	if(pages > stats->largestExtent) stats->largestExtent = pages;
+}
+
+void kheapCountExtents(int n, struct kheapFreeStats* stats){
+	if(n == 0) return;
+	kheapCountExtents(freeExtents[n].left[ADDRESS_TREE], stats);
+	kheapCountFree(stats, freeExtents[n].pages);
+	kheapCountExtents(freeExtents[n].right[ADDRESS_TREE], stats);
+}
+
+int kheapPlaceBlock(uint32 pages){
+	int n = 0;
+	if(isKHeapPlacementStrategyCONTINUOUS()){
+		//keep moving the break while there is room above it
+		uint32 brk = kheapPageNumber(kernelInside);
+		if(brk < KHEAP_PAGES) n = extentContaining(brk);
+		if(n != 0 && extentEnd(n) - brk >= pages){
+			extentCarve(n, brk, pages);
+			kernelInside = kheapPageAddress(brk + pages);
+			return brk;
+		}
+
+		//the break reached the end of the heap, reuse the freed extents instead
+		n = extentFindFrom(extentRoot[ADDRESS_TREE], pages, 0);
+	}
+	else if(isKHeapPlacementStrategyFIRSTFIT())
+		n = extentFindFrom(extentRoot[ADDRESS_TREE], pages, 0);
+	else if(isKHeapPlacementStrategyBESTFIT())
+		n = extentFindBest(pages);
+	else if(isKHeapPlacementStrategyNEXTFIT()){
+		n = extentFindFrom(extentRoot[ADDRESS_TREE], pages, nextFitPage);
+		//wrap around
+		if(n == 0) n = extentFindFrom(extentRoot[ADDRESS_TREE], pages, 0);
+	}
+
+	if(n == 0) return -1;
+
+	uint32 page = freeExtents[n].start;
+	extentCarve(n, page, pages);
+	nextFitPage = page + pages;
+	return page;
+}
+
+//==================================================================================//
+//================================== BUDDY MODE ====================================//
+//==================================================================================//
+
+//the smallest order holding the given number of pages
+int buddyOrder(uint32 pages){
+	int order = 0;
+	while((1 << order) < pages) order++;
+	return order;
+}
+
+//only the requested pages of a block are mapped, the rest of the block stays
+//reserved until the block is freed
+int buddyAlloc(uint32 pages){
+	int order = buddyOrder(pages);
+	if(order > BUDDY_MAX_ORDER) return -1;
+
+	int o = order;
+	while(o <= BUDDY_MAX_ORDER && buddyFreeLists[o] == BUDDY_NONE) o++;
+	if(o > BUDDY_MAX_ORDER) return -1;
+
+	uint32 page = buddyFreeLists[o];
+	buddyUnlink(page, o);
+
+	//split, keep the lower half and free the upper one
+	while(o > order){
+		o--;
+		buddyPush(page + (1 << o), o);
+	}
+	return page;
+}
+
+void buddyFree(uint32 page, uint32 pages){
+	int order = buddyOrder(pages);
+
+	//merge with the buddy as long as it is free with the same order
+	while(order < BUDDY_MAX_ORDER){
+		uint32 buddy = page ^ (1 << order);
+		if(buddy >= KHEAP_PAGES || buddyFreeOrder[buddy] != order + 1) break;
+		buddyUnlink(buddy, order);
+		page &= ~(1 << order);
+		order++;
+	}
+	buddyPush(page, order);
+}
+
+void buddyPush(uint32 page, int order){
+	buddyFreeOrder[page] = order + 1;
+	buddyPrev[page] = BUDDY_NONE;
+	buddyNext[page] = buddyFreeLists[order];
+	if(buddyFreeLists[order] != BUDDY_NONE) buddyPrev[buddyFreeLists[order]] = page;
+	buddyFreeLists[order] = page;
+}
+
+void buddyUnlink(uint32 page, int order){
+	uint32 prev = buddyPrev[page], next = buddyNext[page];
+	if(prev != BUDDY_NONE) buddyNext[prev] = next;
+	else buddyFreeLists[order] = next;
+	if(next != BUDDY_NONE) buddyPrev[next] = prev;
+	buddyFreeOrder[page] = 0;
+}
+
+uint32 buddyFreeBlocks(int order){
+	uint32 count = 0, page;
+	for(page = buddyFreeLists[order]; page != BUDDY_NONE; page = buddyNext[page]) count++;
+	return count;
+}
+
+//==================================================================================//
+//============================== FREE EXTENTS INDEX ================================//
+//==================================================================================//
+
+uint32 extentEnd(int n){
+	return freeExtents[n].start + freeExtents[n].pages;
+}
+
+int extentNew(uint32 start, uint32 pages){
+	int n = unusedExtents;
+	if(n == 0) panic("kheap: no more free extent nodes");
+	unusedExtents = freeExtents[n].left[ADDRESS_TREE];
+
+	extentSeed = extentSeed * 1103515245 + 12345;
+	freeExtents[n].priority = extentSeed >> 16;
+	freeExtents[n].start = start;
+	freeExtents[n].pages = pages;
+	return n;
+}
+
+void extentDelete(int n){
+	freeExtents[n].left[ADDRESS_TREE] = unusedExtents;
+	unusedExtents = n;
+}
+
+//is node n ordered before the key (pages, start) in the given tree?
+int extentBefore(int tree, int n, uint32 pages, uint32 start){
+	if(tree == SIZE_TREE && freeExtents[n].pages != pages)
+		return freeExtents[n].pages < pages;
+	return freeExtents[n].start < start;
+}
+
+void extentUpdate(int tree, int n){
+	if(tree != ADDRESS_TREE) return;
+	uint32 max = freeExtents[n].pages;
+	int l = freeExtents[n].left[ADDRESS_TREE], r = freeExtents[n].right[ADDRESS_TREE];
+	if(l != 0 && freeExtents[l].maxPages > max) max = freeExtents[l].maxPages;
+	if(r != 0 && freeExtents[r].maxPages > max) max = freeExtents[r].maxPages;
+	freeExtents[n].maxPages = max;
+}
+
+//split the subtree n into the nodes ordered before the key (pages, start) and the rest
+void extentSplit(int tree, int n, uint32 pages, uint32 start, uint16* before, uint16* rest){
+	if(n == 0){
+		*before = *rest = 0;
+		return;
+	}
+	if(extentBefore(tree, n, pages, start)){
+		extentSplit(tree, freeExtents[n].right[tree], pages, start, &freeExtents[n].right[tree], rest);
+		*before = n;
+	}
+	else{
+		extentSplit(tree, freeExtents[n].left[tree], pages, start, before, &freeExtents[n].left[tree]);
+		*rest = n;
+	}
+	extentUpdate(tree, n);
+}
+
+//merge two subtrees, all nodes of a are ordered before the nodes of b
+int extentMerge(int tree, int a, int b){
+	if(a == 0) return b;
+	if(b == 0) return a;
+	if(freeExtents[a].priority > freeExtents[b].priority){
+		freeExtents[a].right[tree] = extentMerge(tree, freeExtents[a].right[tree], b);
+		extentUpdate(tree, a);
+		return a;
+	}
+	freeExtents[b].left[tree] = extentMerge(tree, a, freeExtents[b].left[tree]);
+	extentUpdate(tree, b);
+	return b;
+}
+
+void extentInsert(int n){
+	int tree;
+	uint16 before, rest;
+	for(tree = ADDRESS_TREE; tree <= SIZE_TREE; tree++){
+		freeExtents[n].left[tree] = freeExtents[n].right[tree] = 0;
+		extentUpdate(tree, n);
+		extentSplit(tree, extentRoot[tree], freeExtents[n].pages, freeExtents[n].start, &before, &rest);
+		extentRoot[tree] = extentMerge(tree, extentMerge(tree, before, n), rest);
+	}
+}
+
+void extentRemove(int n){
+	int tree;
+	uint16 before, node, rest;
+	for(tree = ADDRESS_TREE; tree <= SIZE_TREE; tree++){
+		extentSplit(tree, extentRoot[tree], freeExtents[n].pages, freeExtents[n].start, &before, &rest);
+		extentSplit(tree, rest, freeExtents[n].pages, freeExtents[n].start + 1, &node, &rest);
+		extentRoot[tree] = extentMerge(tree, before, rest);
+	}
+}
+
+//the extent containing the given page (0 if the page is allocated)
+int extentContaining(uint32 page){
+	int n = extentRoot[ADDRESS_TREE];
+	while(n != 0){
+		if(page < freeExtents[n].start) n = freeExtents[n].left[ADDRESS_TREE];
+		else if(page >= extentEnd(n)) n = freeExtents[n].right[ADDRESS_TREE];
+		else return n;
+	}
+	return 0;
+}
+
+//the lowest extent of the subtree n that ends after fromPage and has at least the given pages
+int extentFindFrom(int n, uint32 pages, uint32 fromPage){
+	if(n == 0 || freeExtents[n].maxPages < pages) return 0;
+
+	//n and its whole left subtree end before fromPage
+	if(extentEnd(n) <= fromPage)
+		return extentFindFrom(freeExtents[n].right[ADDRESS_TREE], pages, fromPage);
+
+	int found = extentFindFrom(freeExtents[n].left[ADDRESS_TREE], pages, fromPage);
+	if(found != 0) return found;
+	if(freeExtents[n].pages >= pages) return n;
+	return extentFindFrom(freeExtents[n].right[ADDRESS_TREE], pages, fromPage);
+}
+
+//the smallest extent with at least the given pages (the lowest one on ties)
+int extentFindBest(uint32 pages){
+	int n = extentRoot[SIZE_TREE], found = 0;
+	while(n != 0){
+		if(freeExtents[n].pages >= pages){
+			found = n;
+			n = freeExtents[n].left[SIZE_TREE];
+		}
+		else n = freeExtents[n].right[SIZE_TREE];
+	}
+	return found;
+}
+
+//take the pages [page, page + pages) out of the extent n containing them
+void extentCarve(int n, uint32 page, uint32 pages){
+	uint32 start = freeExtents[n].start, end = extentEnd(n);
+	extentRemove(n);
+
+	//the part before the block keeps the node
+	if(page > start){
+		freeExtents[n].pages = page - start;
+		extentInsert(n);
+		n = 0;
+	}
+
+	//the part after the block
+	if(page + pages < end){
+		if(n == 0) n = extentNew(page + pages, end - (page + pages));
+		freeExtents[n].start = page + pages;
+		freeExtents[n].pages = end - (page + pages);
+		extentInsert(n);
+	}
+	else if(n != 0) extentDelete(n);
+}
+
+//add the pages [page, page + pages) to the free extents, coalescing with the neighbors
+void extentRelease(uint32 page, uint32 pages){
+	int prev = (page > 0) ? extentContaining(page - 1) : 0;
+	int next = (page + pages < KHEAP_PAGES) ? extentContaining(page + pages) : 0;
+
+	if(prev != 0){
+		extentRemove(prev);
+		page = freeExtents[prev].start;
+		pages += freeExtents[prev].pages;
+	}
+	if(next != 0){
+		extentRemove(next);
+		pages += freeExtents[next].pages;
+	}
+
+	int n;
+	if(prev != 0){
+		n = prev;
+		if(next != 0) extentDelete(next);
+	}
+	else if(next != 0) n = next;
+	else n = extentNew(page, pages);
+
+	freeExtents[n].start = page;
+	freeExtents[n].pages = pages;
+	extentInsert(n);
+}
+
+//==================================================================================//
+//============================ KERNEL HEAP STRATEGIES ==============================//
+//==================================================================================//
+
+void setKHeapPlacementStrategyCONTINUOUS(){_KHeapPlacementStrategy = KHP_PLACE_CONTINUOUS;}
+void setKHeapPlacementStrategyFIRSTFIT(){_KHeapPlacementStrategy = KHP_PLACE_FIRSTFIT;}
+void setKHeapPlacementStrategyBESTFIT(){_KHeapPlacementStrategy = KHP_PLACE_BESTFIT;}
+void setKHeapPlacementStrategyNEXTFIT(){_KHeapPlacementStrategy = KHP_PLACE_NEXTFIT;}
+
+uint32 isKHeapPlacementStrategyCONTINUOUS(){if(_KHeapPlacementStrategy == KHP_PLACE_CONTINUOUS) return 1; return 0;}
+uint32 isKHeapPlacementStrategyFIRSTFIT(){if(_KHeapPlacementStrategy == KHP_PLACE_FIRSTFIT) return 1; return 0;}
+uint32 isKHeapPlacementStrategyBESTFIT(){if(_KHeapPlacementStrategy == KHP_PLACE_BESTFIT) return 1; return 0;}
+uint32 isKHeapPlacementStrategyNEXTFIT(){if(_KHeapPlacementStrategy == KHP_PLACE_NEXTFIT) return 1; return 0;}
+
+//the mode can only be changed while the kernel heap is empty, the free objects of
+//the caches are given back first
+int enableKHeapBuddy(uint32 enableIt){
+	kmem_cache_reap();
+	if(kheapUsedPages != 0) return -1;
+	_EnableKHeapBuddy = enableIt;
+	initialize_kheap();
+	return 0;
 }
+uint32 isKHeapBuddyEnabled(){if(_EnableKHeapBuddy) return 1; return 0;}
@@ -5,11 +5,129 @@
 # error "This is a FOS kernel header; user programs should not #include it"
 #endif
 
+//Values for kernel heap placement strategy
+#define KHP_PLACE_CONTINUOUS	0x0
+#define KHP_PLACE_FIRSTFIT 	0x1
+#define KHP_PLACE_BESTFIT 	0x2
+#define KHP_PLACE_NEXTFIT 	0x3
+
+uint32 _KHeapPlacementStrategy;
+
+void setKHeapPlacementStrategyCONTINUOUS();
+void setKHeapPlacementStrategyFIRSTFIT();
+void setKHeapPlacementStrategyBESTFIT();
+void setKHeapPlacementStrategyNEXTFIT();
+
+uint32 isKHeapPlacementStrategyCONTINUOUS();
+uint32 isKHeapPlacementStrategyFIRSTFIT();
+uint32 isKHeapPlacementStrategyBESTFIT();
+uint32 isKHeapPlacementStrategyNEXTFIT();
+
+//Kernel heap buddy mode: blocks of 2^order pages, naturally aligned, split and
+//merged in O(BUDDY_MAX_ORDER). The placement strategy is not used in this mode.
+//The mode can only be changed while the kernel heap is empty.
+uint32 _EnableKHeapBuddy;
+
+int enableKHeapBuddy(uint32 enableIt);
+uint32 isKHeapBuddyEnabled();
+
+//number of pages in the kernel heap
+#define KHEAP_PAGES ((KERNEL_HEAP_MAX - KERNEL_HEAP_START) / PAGE_SIZE)
+
+//convert between kernel heap virtual addresses and kernel heap page numbers
+#define kheapPageNumber(va) (((uint32)(va) - KERNEL_HEAP_START) / PAGE_SIZE)
+#define kheapPageAddress(page) (KERNEL_HEAP_START + (uint32)(page) * PAGE_SIZE)
+
+//largest buddy block: 2^13 pages (32 MB), KERNEL_HEAP_START is aligned to it
+#define BUDDY_MAX_ORDER 13
+#define BUDDY_NONE 0xFFFF
+
+struct kmem_cache;
+
+//info of each kernel heap page, indexed by kernel heap page number
+struct kheapBlock{
+	//number of pages of the block allocated at this page (0 if no block starts here)
+	uint16 pages;
+	//slab pages of small objects: number of allocated objects and the links of
+	//the partial slabs list of their cache
+	uint16 inuse;
+	uint16 prevSlab, nextSlab;
+	//the cache owning the block (NULL if it is not a cache object)
+	struct kmem_cache* cache;
+	//slab pages: the free objects, linked through their first word
+	void* freeObjects;
+	//the entry of the kmalloc caller in kheapCallers
+	uint8 caller;
+	//the page belongs to a reserved block (kmalloc_reserve), it is mapped on its first access
+	uint8 lazy;
+};
+extern struct kheapBlock kheapBlocks[];
+
+//allocation totals of each kmalloc caller (entry 0 counts the callers that don't fit)
+#define MAX_KHEAP_CALLERS 32
+struct kheapCaller{
+	uint32 eip;
+	uint32 blocks, pages;
+};
+extern struct kheapCaller kheapCallers[];
+extern int numOfKheapCallers;
+extern uint32 kheapUsedPages;
+extern uint32 kheapLazyPages;
+
+//free extents histogram buckets: 1, 2-3, 4-7, ... pages
+#define KHEAP_HISTOGRAM_BUCKETS 16
+struct kheapFreeStats{
+	uint32 freePages;
+	uint32 freeExtents;
+	uint32 largestExtent;
+	uint32 histogram[KHEAP_HISTOGRAM_BUCKETS];
+};
+
+void initialize_kheap();
 void* kmalloc(unsigned int size);
 void kfree(void* virtual_address);
+void* krealloc(void* virtual_address, uint32 new_size);
+void* kmalloc_reserve(unsigned int size);
+void* kmalloc_zeroed(unsigned int size);
+int kheap_fault_handler(uint32 fault_va);
 
 //my helper functions
-int findBlock(void*);
+void* kmalloc_caller(unsigned int size, int zeroed, uint32 eip);
+void* kheapMapBlock(uint32 pages, int zeroed, uint32 eip);
+void kheapSetCache(void* virtual_address, struct kmem_cache* cache);
+void kheapSetLazy(uint32 page, uint32 pages, uint8 lazy);
+int kheapPlaceBlock(uint32 pages);
+int kheapReserve(uint32 pages);
+void kheapGetFreeStats(struct kheapFreeStats* stats);
+void kheapCountFree(struct kheapFreeStats* stats, uint32 pages);
+void kheapCountExtents(int n, struct kheapFreeStats* stats);
+void kheapTrackCaller(uint32 page, uint32 eip);
+void kheapUntrackCaller(uint32 page);
+int kheapExtendBlock(uint32 page, uint32 oldPages, uint32 newPages);
+void kheapShrinkBlock(uint32 page, uint32 oldPages, uint32 newPages);
+void kheapRelease(uint32 page, uint32 pages);
+
+int buddyOrder(uint32 pages);
+int buddyAlloc(uint32 pages);
+void buddyFree(uint32 page, uint32 pages);
+void buddyPush(uint32 page, int order);
+void buddyUnlink(uint32 page, int order);
+uint32 buddyFreeBlocks(int order);
+
+uint32 extentEnd(int n);
+int extentNew(uint32 start, uint32 pages);
+void extentDelete(int n);
+int extentBefore(int tree, int n, uint32 pages, uint32 start);
+void extentUpdate(int tree, int n);
+void extentSplit(int tree, int n, uint32 pages, uint32 start, uint16* before, uint16* rest);
+int extentMerge(int tree, int a, int b);
+void extentInsert(int n);
+void extentRemove(int n);
+int extentContaining(uint32 page);
+int extentFindFrom(int n, uint32 pages, uint32 fromPage);
+int extentFindBest(uint32 pages);
+void extentCarve(int n, uint32 page, uint32 pages);
+void extentRelease(uint32 page, uint32 pages);
 
 unsigned int kheap_virtual_address(unsigned int physical_address);
 unsigned int kheap_physical_address(unsigned int virtual_address);
@@ -0,0 +1,284 @@
+#include <inc/memlayout.h>
+#include <inc/string.h>
+#include <inc/stdio.h>
+#include <inc/assert.h>
+#include <kern/kmem_cache.h>
+#include <kern/kheap.h>
+
+//my helper global arrays
+struct kmem_cache kmemCaches[MAX_KMEM_CACHES];
+int numOfKmemCaches = 0;
+
+struct kmem_cache* kmallocCaches[KMALLOC_SIZE_CLASSES];
+char* kmallocCacheNames[KMALLOC_SIZE_CLASSES] = {
+	"kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+	"kmalloc-256", "kmalloc-512", "kmalloc-1024"
+};
+
+struct kmem_cache* page_directory_cache = NULL;
+struct kmem_cache* page_table_cache = NULL;
+struct kmem_cache* disk_table_cache = NULL;
+
+void initialize_kmem_caches()
+{
+	page_directory_cache = kmem_cache_create("page_directory", PAGE_SIZE, NULL);
+	page_table_cache = kmem_cache_create("page_table", PAGE_SIZE, kmem_zero_ctor);
+	disk_table_cache = kmem_cache_create("disk_table", PAGE_SIZE, kmem_zero_ctor);
+
+	int i;
+	for(i = 0; i < KMALLOC_SIZE_CLASSES; i++)
+		kmallocCaches[i] = kmem_cache_create(kmallocCacheNames[i], KMALLOC_MIN_SMALL << i, NULL);
+}
+
+uint32 kmem_cache_object_size(uint32 object_size)
+{
+	if(object_size < PAGE_SIZE) return ROUNDUP(object_size, KMALLOC_MIN_SMALL);
+	return ROUNDUP(object_size, PAGE_SIZE);
+}
+
+struct kmem_cache* kmem_cache_create(char* name, uint32 object_size, void (*ctor)(void*, uint32))
+{
+	if(numOfKmemCaches == MAX_KMEM_CACHES) return NULL;
+
+	struct kmem_cache* cache = &kmemCaches[numOfKmemCaches++];
+	memset(cache, 0, sizeof(*cache));
+	strncpy(cache->name, name, KMEM_CACHE_NAME_LEN - 1);
+	cache->object_size = kmem_cache_object_size(object_size);
+	cache->ctor = ctor;
+	cache->partial_slabs = KMEM_NO_SLAB;
+
+	if(cache->object_size < PAGE_SIZE){
+		cache->objects_per_slab = PAGE_SIZE / cache->object_size;
+		cache->capacity = KMEM_CACHE_EMPTY_SLABS;
+		return cache;
+	}
+
+	//keep at most KMEM_CACHE_IDLE_FRAMES frames idle, but at least one object
+	cache->capacity = KMEM_CACHE_IDLE_FRAMES / (cache->object_size / PAGE_SIZE);
+	if(cache->capacity > KMEM_CACHE_DEPTH) cache->capacity = KMEM_CACHE_DEPTH;
+	if(cache->capacity == 0) cache->capacity = 1;
+
+	return cache;
+}
+
+//find the cache with the given name and object size, create it if it does not exist
+struct kmem_cache* kmem_cache_lookup(char* name, uint32 object_size, void (*ctor)(void*, uint32))
+{
+	int i;
+	for(i = 0; i < numOfKmemCaches; i++)
+		if(kmemCaches[i].object_size == kmem_cache_object_size(object_size) && strcmp(kmemCaches[i].name, name) == 0)
+			return &kmemCaches[i];
+
+	return kmem_cache_create(name, object_size, ctor);
+}
+
+//the kmalloc cache of the smallest size class holding size bytes
+struct kmem_cache* kmalloc_size_class(uint32 size)
+{
+	int i = 0;
+	while(i < KMALLOC_SIZE_CLASSES - 1 && (KMALLOC_MIN_SMALL << i) < size) i++;
+	return kmallocCaches[i];
+}
+
+void* kmem_cache_alloc(struct kmem_cache* cache)
+{
+	return kmem_cache_alloc_caller(cache, (uint32) __builtin_return_address(0));
+}
+
+//kmem_cache_alloc() charged to the given caller in kheapCallers
+void* kmem_cache_alloc_caller(struct kmem_cache* cache, uint32 eip)
+{
+	void* object;
+	if(cache->object_size < PAGE_SIZE){
+		object = kmem_slab_alloc(cache, eip);
+		if(object == NULL) return NULL;
+		if(cache->ctor != NULL) cache->ctor(object, cache->object_size);
+	}
+	else if(cache->free_objects > 0){
+		//reuse a free object, it is still mapped and already constructed
+		object = cache->objects[--cache->free_objects];
+		cache->hits++;
+
+		//the block is charged to its new owner
+		uint32 page = kheapPageNumber(object);
+		kheapUntrackCaller(page);
+		kheapTrackCaller(page, eip);
+	}
+	else{
+		//zeroed objects get frames of the zeroed frames pool instead of running the constructor
+		object = kmalloc_caller(cache->object_size, cache->ctor == kmem_zero_ctor, eip);
+		if(object == NULL) return NULL;
+
+		//kfree() of this object will bring it back to this cache
+		kheapSetCache(object, cache);
+		if(cache->ctor != NULL && cache->ctor != kmem_zero_ctor) cache->ctor(object, cache->object_size);
+		cache->misses++;
+	}
+	cache->allocated_objects++;
+	return object;
+}
+
+void kmem_cache_free(struct kmem_cache* cache, void* object)
+{
+	cache->allocated_objects--;
+	if(cache->object_size < PAGE_SIZE){
+		kmem_slab_free(cache, object);
+		return;
+	}
+
+	if(cache->free_objects < cache->capacity){
+		if(cache->ctor != NULL) cache->ctor(object, cache->object_size);
+		cache->objects[cache->free_objects++] = object;
+		return;
+	}
+
+	//the cache is full, give the object back to the kernel heap
+	kheapSetCache(object, NULL);
+	kfree(object);
+}
+
+//give all free objects of all caches back to the kernel heap, returns the released frames
+uint32 kmem_cache_reap()
+{
+	uint32 frames = 0;
+	int i;
+	for(i = 0; i < numOfKmemCaches; i++){
+		struct kmem_cache* cache = &kmemCaches[i];
+		while(cache->free_objects > 0){
+			void* object = cache->objects[--cache->free_objects];
+			kheapSetCache(object, NULL);
+			kfree(object);
+			frames += cache->object_size / PAGE_SIZE;
+		}
+
+		//release the empty slabs
+		uint32 page = cache->partial_slabs;
+		while(page != KMEM_NO_SLAB){
+			uint32 next = kheapBlocks[page].nextSlab;
+			if(kheapBlocks[page].inuse == 0){
+				kmem_slab_release(cache, page);
+				frames++;
+			}
+			page = next;
+		}
+	}
+	return frames;
+}
+
+//number of frames held by free objects (they can be reclaimed at any time)
+uint32 kmem_cache_idle_frames()
+{
+	uint32 frames = 0;
+	int i;
+	for(i = 0; i < numOfKmemCaches; i++)
+		frames += kmemCaches[i].free_objects * (kmemCaches[i].object_size / PAGE_SIZE) + kmemCaches[i].empty_slabs;
+	return frames;
+}
+
+//frames that the small objects would take if each one had its own page
+uint32 kmem_cache_small_frames_saved()
+{
+	uint32 saved = 0;
+	int i;
+	for(i = 0; i < numOfKmemCaches; i++)
+		if(kmemCaches[i].object_size < PAGE_SIZE)
+			saved += kmemCaches[i].allocated_objects - (kmemCaches[i].slabs - kmemCaches[i].empty_slabs);
+	return saved;
+}
+
+void kmem_cache_print()
+{
+	int i;
+	cprintf("cache\t\tobject size\tallocated\tfree\thits\tmisses\tslabs\n");
+	for(i = 0; i < numOfKmemCaches; i++){
+		struct kmem_cache* cache = &kmemCaches[i];
+		cprintf("%s\t%d\t\t%d\t\t%d\t%d\t%d\t%d\n", cache->name, cache->object_size,
+				cache->allocated_objects, cache->free_objects, cache->hits, cache->misses, cache->slabs);
+	}
+}
+
+void kmem_zero_ctor(void* object, uint32 size)
+{
+	memset(object, 0, size);
+}
+
+//==================================================================================//
+//=============================== SMALL OBJECT SLABS ===============================//
+//==================================================================================//
+
+void* kmem_slab_alloc(struct kmem_cache* cache, uint32 eip){
+	//no slab has free objects, carve a new page (charged to the caller that needs it)
+	if(cache->partial_slabs == KMEM_NO_SLAB){
+		char* slabVA = kmalloc_caller(PAGE_SIZE, 0, eip);
+		if(slabVA == NULL) return NULL;
+		cache->misses++;
+
+		uint32 page = kheapPageNumber(slabVA);
+		struct kheapBlock* slab = &kheapBlocks[page];
+		slab->cache = cache;
+		slab->inuse = 0;
+		slab->freeObjects = NULL;
+
+		int i;
+		for(i = cache->objects_per_slab - 1; i >= 0; i--){
+			void* object = slabVA + i * cache->object_size;
+			*(void**)object = slab->freeObjects;
+			slab->freeObjects = object;
+		}
+
+		kmem_slab_link(cache, page);
+		cache->slabs++;
+		cache->empty_slabs++;
+	}
+	else cache->hits++;
+
+	uint32 page = cache->partial_slabs;
+	struct kheapBlock* slab = &kheapBlocks[page];
+	void* object = slab->freeObjects;
+	slab->freeObjects = *(void**)object;
+
+	if(slab->inuse++ == 0) cache->empty_slabs--;
+	//a full slab leaves the partial slabs list
+	if(slab->freeObjects == NULL) kmem_slab_unlink(cache, page);
+
+	return object;
+}
+
+void kmem_slab_free(struct kmem_cache* cache, void* object){
+	uint32 page = kheapPageNumber(object);
+	struct kheapBlock* slab = &kheapBlocks[page];
+
+	//a full slab has a free object again
+	if(slab->freeObjects == NULL) kmem_slab_link(cache, page);
+	*(void**)object = slab->freeObjects;
+	slab->freeObjects = object;
+
+	if(--slab->inuse == 0){
+		cache->empty_slabs++;
+		if(cache->empty_slabs > cache->capacity) kmem_slab_release(cache, page);
+	}
+}
+
+//give an empty slab page back to the kernel heap
+void kmem_slab_release(struct kmem_cache* cache, uint32 page){
+	kmem_slab_unlink(cache, page);
+	kheapBlocks[page].cache = NULL;
+	kheapBlocks[page].freeObjects = NULL;
+	cache->slabs--;
+	cache->empty_slabs--;
+	kfree((void*) kheapPageAddress(page));
+}
+
+void kmem_slab_link(struct kmem_cache* cache, uint32 page){
+	kheapBlocks[page].prevSlab = KMEM_NO_SLAB;
+	kheapBlocks[page].nextSlab = cache->partial_slabs;
+	if(cache->partial_slabs != KMEM_NO_SLAB) kheapBlocks[cache->partial_slabs].prevSlab = page;
+	cache->partial_slabs = page;
+}
+
+void kmem_slab_unlink(struct kmem_cache* cache, uint32 page){
+	uint32 prev = kheapBlocks[page].prevSlab, next = kheapBlocks[page].nextSlab;
+	if(prev != KMEM_NO_SLAB) kheapBlocks[prev].nextSlab = next;
+	else cache->partial_slabs = next;
+	if(next != KMEM_NO_SLAB) kheapBlocks[next].prevSlab = prev;
+}
@@ -0,0 +1,81 @@
+#ifndef FOS_KERN_KMEM_CACHE_H_
+#define FOS_KERN_KMEM_CACHE_H_
+
+#ifndef FOS_KERNEL
+# error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+
+#define KMEM_CACHE_NAME_LEN	16
+#define MAX_KMEM_CACHES		32
+//max number of free objects kept by one cache
+#define KMEM_CACHE_DEPTH	64
+//max number of frames kept idle by one cache
+#define KMEM_CACHE_IDLE_FRAMES	64
+//max number of empty slab pages kept by one cache of small objects
+#define KMEM_CACHE_EMPTY_SLABS	1
+//end of a partial slabs list
+#define KMEM_NO_SLAB		0xFFFF
+
+//kmalloc size classes: 16, 32, ..., KMALLOC_MAX_SMALL bytes
+#define KMALLOC_MIN_SMALL	16
+#define KMALLOC_MAX_SMALL	1024
+#define KMALLOC_SIZE_CLASSES	7
+
+//A cache of fixed-size kernel heap objects. Freed objects are kept (still mapped)
+//and handed back by the next kmem_cache_alloc, so they skip the kmalloc/kfree
+//map/unmap round trip. The constructor (if any) is applied to every object
+//before it enters the cache, so allocated objects are always constructed.
+//
+//Objects smaller than a page are carved from slab pages shared by several
+//objects of the same cache; their constructor is applied on allocation.
+struct kmem_cache
+{
+	char name[KMEM_CACHE_NAME_LEN];
+	uint32 object_size;		//multiple of PAGE_SIZE, or of KMALLOC_MIN_SMALL if smaller
+	uint32 capacity;		//max number of free objects (empty slabs) to keep
+	void (*ctor)(void* object, uint32 size);
+
+	void* objects[KMEM_CACHE_DEPTH];	//the free objects
+	uint32 free_objects;
+	uint32 allocated_objects;
+	uint32 hits, misses;
+
+	//small objects only
+	uint32 objects_per_slab;
+	uint32 partial_slabs;		//slab pages with free objects (KMEM_NO_SLAB if none)
+	uint32 slabs, empty_slabs;
+};
+
+//the caches of the kernel paging structures
+extern struct kmem_cache* page_directory_cache;	//user page directories
+extern struct kmem_cache* page_table_cache;	//user page tables (zeroed)
+extern struct kmem_cache* disk_table_cache;	//disk page tables and directories (zeroed)
+
+void initialize_kmem_caches();
+
+struct kmem_cache* kmem_cache_create(char* name, uint32 object_size, void (*ctor)(void*, uint32));
+struct kmem_cache* kmem_cache_lookup(char* name, uint32 object_size, void (*ctor)(void*, uint32));
+void* kmem_cache_alloc(struct kmem_cache* cache);
+void* kmem_cache_alloc_caller(struct kmem_cache* cache, uint32 eip);
+void kmem_cache_free(struct kmem_cache* cache, void* object);
+uint32 kmem_cache_reap();
+uint32 kmem_cache_idle_frames();
+void kmem_cache_print();
+
+struct kmem_cache* kmalloc_size_class(uint32 size);
+uint32 kmem_cache_small_frames_saved();
+
+//my helper functions
+uint32 kmem_cache_object_size(uint32 object_size);
+void* kmem_slab_alloc(struct kmem_cache* cache, uint32 eip);
+void kmem_slab_free(struct kmem_cache* cache, void* object);
+void kmem_slab_release(struct kmem_cache* cache, uint32 page);
+void kmem_slab_link(struct kmem_cache* cache, uint32 page);
+void kmem_slab_unlink(struct kmem_cache* cache, uint32 page);
+
+//constructors
+void kmem_zero_ctor(void* object, uint32 size);
+
+#endif // FOS_KERN_KMEM_CACHE_H_
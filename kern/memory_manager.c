@@ -23,11 +23,16 @@ FUNCTIONS:	to_physical_address, get_frame_info, tlb_invalidate
 #include <kern/user_environment.h>
 #include <kern/sched.h>
 #include <kern/kheap.h>
+#include <kern/kmem_cache.h>
 
 //my helper functions
 void freeEnvPageTables(struct Env* e, uint32 virtualAddress, uint32 size);
-int checkPageTable(struct Env* e, uint32 virtualAddress);
-void freePageTable(struct Env* e, uint32 virtualAddress);
+int checkPageTable(struct Env* e, uint32 virtualAddress, uint32 freedAddress, uint32 freedSize);
+int freePageTable(struct Env* e, uint32 virtualAddress);
+extern void __pf_remove_env_table(struct Env* ptr_env, uint32 virtual_address);
+extern uint32 isBufferingEnabled();
+extern uint32 getModifiedBufferLength();
+extern struct AnonRegion_List freeAnonRegions;
 
 extern uint32 number_of_frames;	// Amount of physical memory (in frames_info)
 extern uint32 size_of_base_mem;		// Amount of base memory (in bytes)
@@ -57,6 +62,9 @@ char* ptr_free_mem;	// Pointer to next byte of free mem
 struct Frame_Info* frames_info;		// Virtual address of physical frames_info array
 struct Frame_Info* disk_frames_info;		// Virtual address of physical frames_info array
 struct Linked_List free_frame_list;	// Free list of physical frames_info
+struct Linked_List zeroed_frame_list;	// Free frames that are already zeroed
+struct Linked_List frame_buddy_lists[FRAME_BUDDY_MAX_ORDER + 1];	// Free blocks of 2^order contiguous frames
+uint32 zeroedFrameHits = 0, zeroedFrameMisses = 0;
 struct Linked_List modified_frame_list;
 
 
@@ -341,6 +349,9 @@ void initialize_paging()
 	// Change the code to reflect this.
 	int i;
 	LIST_INIT(&free_frame_list);
+	LIST_INIT(&zeroed_frame_list);
+	for (i = 0; i <= FRAME_BUDDY_MAX_ORDER; i++)
+		LIST_INIT(&frame_buddy_lists[i]);
 	LIST_INIT(&modified_frame_list);
 
 	frames_info[0].references = 1;
@@ -349,7 +360,8 @@ void initialize_paging()
 	ptr_zero_page = (uint8*) KERNEL_BASE+PAGE_SIZE;
 	ptr_temp_page = (uint8*) KERNEL_BASE+2*PAGE_SIZE;
 	i =0;
-	for(;i<1024; i++)
+	//the whole zero page is cleared, user pages share it (see zeroPageCopyOnWrite())
+	for(;i<PAGE_SIZE; i++)
 	{
 		ptr_zero_page[i]=0;
 		ptr_temp_page[i]=0;
@@ -415,7 +427,10 @@ void initialize_frame_info(struct Frame_Info *ptr_frame_info)
 // Hint: references should not be incremented
 int allocate_frame(struct Frame_Info **ptr_frame_info)
 {
-	*ptr_frame_info = LIST_FIRST(&free_frame_list);
+	*ptr_frame_info = remove_free_frame();
+	//give the idle objects of the kernel caches back before giving up
+	if (*ptr_frame_info == NULL && kmem_cache_reap() > 0)
+		*ptr_frame_info = remove_free_frame();
 	if (*ptr_frame_info == NULL)
 	{
 		//TODO: [PROJECT 2016 - BONUS5] Free RAM when it's FULL
@@ -426,8 +441,6 @@ int allocate_frame(struct Frame_Info **ptr_frame_info)
 		//	2-	otherwise, free at least 1 frame from the user working set by applying the clock algorithm
 	}
 
-	LIST_REMOVE(&free_frame_list,*ptr_frame_info);
-
 	/******************* PAGE BUFFERING CODE *******************
 	 ***********************************************************/
 
@@ -445,9 +458,280 @@ int allocate_frame(struct Frame_Info **ptr_frame_info)
 	return 0;
 }
 
+//
+// Removes a free frame from the free frame lists, in this order: free_frame_list,
+// the zeroed frames pool, the smallest free block of contiguous frames
+// (split in O(FRAME_BUDDY_MAX_ORDER)), then the buffered frames at the tail of
+// free_frame_list (they still hold the evicted pages of their envs).
+// The frame is NOT initialized.
+//
+// RETURNS
+//   the removed frame, NULL if there are no free frames
+//
+struct Frame_Info* remove_free_frame()
+{
+	struct Frame_Info *ptr_frame_info = LIST_FIRST(&free_frame_list);
+	if (ptr_frame_info != NULL && !ptr_frame_info->isBuffered)
+	{
+		LIST_REMOVE(&free_frame_list, ptr_frame_info);
+		return ptr_frame_info;
+	}
+
+	struct Frame_Info *ptr_other_frame_info = LIST_FIRST(&zeroed_frame_list);
+	if (ptr_other_frame_info != NULL)
+	{
+		LIST_REMOVE(&zeroed_frame_list, ptr_other_frame_info);
+		return ptr_other_frame_info;
+	}
+
+	ptr_other_frame_info = frame_buddy_remove(0);
+	if (ptr_other_frame_info != NULL)
+		return ptr_other_frame_info;
+
+	//the buffered frames are at the tail, the first one is the oldest
+	if (ptr_frame_info != NULL)
+		LIST_REMOVE(&free_frame_list, ptr_frame_info);
+	return ptr_frame_info;
+}
+
+//
+// Allocates 2^order physically contiguous frames, the first one is aligned to
+// 2^order frames. Order 0 is the same as allocate_frame().
+// Does NOT set the contents of the frames to zero.
+//
+// *ptr_frame_info -- is set to point to the Frame_Info struct of the first frame,
+// the Frame_Info structs of the other frames follow it in frames_info
+//
+// Details:
+//   - The free frames of free_frame_list are merged into blocks only when no
+//     block is big enough (see coalesce_free_frames), so allocate_frame() and
+//     free_frame() keep their O(1) list operations.
+//
+// RETURNS
+//   0 -- on success
+//   E_NO_MEM -- if there are no 2^order contiguous free frames
+//
+int allocate_frames(struct Frame_Info **ptr_frame_info, uint32 order)
+{
+	if (order == 0)
+		return allocate_frame(ptr_frame_info);
+	if (order > FRAME_BUDDY_MAX_ORDER)
+		return E_NO_MEM;
+
+	*ptr_frame_info = frame_buddy_remove(order);
+	if (*ptr_frame_info == NULL)
+	{
+		coalesce_free_frames();
+		*ptr_frame_info = frame_buddy_remove(order);
+	}
+	if (*ptr_frame_info == NULL && kmem_cache_reap() > 0)
+	{
+		coalesce_free_frames();
+		*ptr_frame_info = frame_buddy_remove(order);
+	}
+	if (*ptr_frame_info == NULL)
+		return E_NO_MEM;
+
+	uint32 i;
+	for (i = 0; i < (1 << order); i++)
+		initialize_frame_info(&((*ptr_frame_info)[i]));
+
+	return 0;
+}
+
+//
+// Returns the 2^order contiguous frames allocated by allocate_frames().
+// (This function should only be called when the references of all the frames are 0.)
+// The block is merged with its free buddies.
+//
+void free_frames(struct Frame_Info *ptr_frame_info, uint32 order)
+{
+	if (order == 0)
+	{
+		free_frame(ptr_frame_info);
+		return;
+	}
+	if (to_frame_number(ptr_frame_info) % (1 << order) != 0)
+		panic("free_frames: the frames are not a block of order %d", order);
+
+	uint32 i;
+	for (i = 0; i < (1 << order); i++)
+		initialize_frame_info(&ptr_frame_info[i]);
+	frame_buddy_insert(ptr_frame_info, order);
+}
+
+//
+// Merges the free frames of free_frame_list into blocks of contiguous frames.
+// Buffered frames still hold the page of their env, they are not merged.
+// The frames that can't be merged go back to free_frame_list.
+//
+void coalesce_free_frames()
+{
+	struct Frame_Info *ptr_frame_info = LIST_FIRST(&free_frame_list);
+	while (ptr_frame_info != NULL)
+	{
+		struct Frame_Info *ptr_next = LIST_NEXT(ptr_frame_info);
+		if (!ptr_frame_info->isBuffered)
+		{
+			LIST_REMOVE(&free_frame_list, ptr_frame_info);
+			frame_buddy_insert(ptr_frame_info, 0);
+		}
+		ptr_frame_info = ptr_next;
+	}
+
+	//order 0 blocks are only used while merging
+	while ((ptr_frame_info = LIST_FIRST(&frame_buddy_lists[0])) != NULL)
+	{
+		frame_buddy_unlink(ptr_frame_info, 0);
+		LIST_INSERT_HEAD(&free_frame_list, ptr_frame_info);
+	}
+}
+
+//insert a free block, merging it with its buddy while the buddy is a free block of the same order
+void frame_buddy_insert(struct Frame_Info *ptr_frame_info, uint32 order)
+{
+	uint32 frame_number = to_frame_number(ptr_frame_info);
+	while (order < FRAME_BUDDY_MAX_ORDER)
+	{
+		uint32 buddy_number = frame_number ^ (1 << order);
+		if (buddy_number >= number_of_frames || frames_info[buddy_number].buddyOrder != order + 1)
+			break;
+		frame_buddy_unlink(&frames_info[buddy_number], order);
+		frame_number &= ~(1 << order);
+		order++;
+	}
+	frame_buddy_push(&frames_info[frame_number], order);
+}
+
+//remove the smallest free block of at least the given order, the rest of it goes back
+//to the lists as smaller blocks (single frames go to free_frame_list)
+struct Frame_Info* frame_buddy_remove(uint32 order)
+{
+	uint32 k = order;
+	while (k <= FRAME_BUDDY_MAX_ORDER && LIST_FIRST(&frame_buddy_lists[k]) == NULL)
+		k++;
+	if (k > FRAME_BUDDY_MAX_ORDER)
+		return NULL;
+
+	struct Frame_Info *ptr_frame_info = LIST_FIRST(&frame_buddy_lists[k]);
+	frame_buddy_unlink(ptr_frame_info, k);
+	while (k > order)
+	{
+		k--;
+		if (k == 0)
+			LIST_INSERT_HEAD(&free_frame_list, ptr_frame_info + 1);
+		else
+			frame_buddy_push(ptr_frame_info + (1 << k), k);
+	}
+	return ptr_frame_info;
+}
+
+void frame_buddy_push(struct Frame_Info *ptr_frame_info, uint32 order)
+{
+	ptr_frame_info->buddyOrder = order + 1;
+	LIST_INSERT_HEAD(&frame_buddy_lists[order], ptr_frame_info);
+}
+
+void frame_buddy_unlink(struct Frame_Info *ptr_frame_info, uint32 order)
+{
+	ptr_frame_info->buddyOrder = 0;
+	LIST_REMOVE(&frame_buddy_lists[order], ptr_frame_info);
+}
+
+//number of frames in the free blocks of contiguous frames
+uint32 frame_buddy_free_frames()
+{
+	uint32 frames = 0;
+	int order;
+	for (order = 0; order <= FRAME_BUDDY_MAX_ORDER; order++)
+		frames += LIST_SIZE(&frame_buddy_lists[order]) << order;
+	return frames;
+}
+
+//
+// Allocates a physical frame whose contents are zero.
+// The frame is taken from the zeroed frames pool, if the pool is empty
+// a free frame is allocated and zeroed now.
+//
+// RETURNS
+//   0 -- on success
+//   If failed, it panic.
+//
+int allocate_zeroed_frame(struct Frame_Info **ptr_frame_info)
+{
+	*ptr_frame_info = LIST_FIRST(&zeroed_frame_list);
+	if (*ptr_frame_info != NULL)
+	{
+		LIST_REMOVE(&zeroed_frame_list, *ptr_frame_info);
+		initialize_frame_info(*ptr_frame_info);
+		zeroedFrameHits++;
+		return 0;
+	}
+
+	int r = allocate_frame(ptr_frame_info);
+	if (r != 0)
+		return r;
+	zero_frame(*ptr_frame_info);
+	zeroedFrameMisses++;
+	return 0;
+}
+
+//
+// Sets the contents of the given frame to zero.
+// With the kernel heap, the frames are not in the kernel direct map, so the frame
+// is mapped for a moment at ZERO_FRAME_WINDOW (kernel page tables are shared by
+// all directories, so this works whatever directory is loaded).
+//
+void zero_frame(struct Frame_Info *ptr_frame_info)
+{
+	uint32 physical_address = to_physical_address(ptr_frame_info);
+	if (!USE_KHEAP)
+	{
+		memset(STATIC_KERNEL_VIRTUAL_ADDRESS(physical_address), 0, PAGE_SIZE);
+		return;
+	}
+
+	uint32 *ptr_page_table;
+	get_page_table(ptr_page_directory, (void*)ZERO_FRAME_WINDOW, &ptr_page_table);
+	ptr_page_table[PTX(ZERO_FRAME_WINDOW)] = CONSTRUCT_ENTRY(physical_address, PERM_PRESENT | PERM_WRITEABLE);
+	invlpg((void*)ZERO_FRAME_WINDOW);
+	memset((void*)ZERO_FRAME_WINDOW, 0, PAGE_SIZE);
+	ptr_page_table[PTX(ZERO_FRAME_WINDOW)] = 0;
+	invlpg((void*)ZERO_FRAME_WINDOW);
+}
+
+//
+// Moves free frames to the zeroed frames pool (zeroing them) until it has
+// "target" frames or there are no more free frames.
+// Buffered free frames still hold the page of their env, they are skipped.
+//
+// RETURNS:
+//   the number of zeroed frames
+//
+uint32 refill_zeroed_frames(uint32 target)
+{
+	uint32 zeroed = 0;
+	struct Frame_Info *ptr_frame_info = LIST_FIRST(&free_frame_list);
+	while (ptr_frame_info != NULL && LIST_SIZE(&zeroed_frame_list) < target)
+	{
+		struct Frame_Info *ptr_next = LIST_NEXT(ptr_frame_info);
+		if (!ptr_frame_info->isBuffered)
+		{
+			LIST_REMOVE(&free_frame_list, ptr_frame_info);
+			zero_frame(ptr_frame_info);
+			LIST_INSERT_HEAD(&zeroed_frame_list, ptr_frame_info);
+			zeroed++;
+		}
+		ptr_frame_info = ptr_next;
+	}
+	return zeroed;
+}
+
 //
 // Return a frame to the free_frame_list.
 // (This function should only be called when ptr_frame_info->references reaches 0.)
+// While the zeroed frames pool is under ZEROED_FRAMES_LOW, the frame is zeroed
+// and goes to the pool instead.
 //
 void free_frame(struct Frame_Info *ptr_frame_info)
 {
@@ -455,6 +739,13 @@ void free_frame(struct Frame_Info *ptr_frame_info)
 	initialize_frame_info(ptr_frame_info);
 	/*=============================================================================*/
 
+	if (LIST_SIZE(&zeroed_frame_list) < ZEROED_FRAMES_LOW)
+	{
+		zero_frame(ptr_frame_info);
+		LIST_INSERT_HEAD(&zeroed_frame_list, ptr_frame_info);
+		return;
+	}
+
 	// Fill this function in
 	LIST_INSERT_HEAD(&free_frame_list, ptr_frame_info);
 	//LOG_STATMENT(cprintf("FN # %d FREED",to_frame_number(ptr_frame_info)));
@@ -542,8 +833,8 @@ void * create_page_table(uint32 *ptr_page_directory, const uint32 virtual_addres
 	//Use kmalloc() to create a new page TABLE for the given virtual address and return the address of the created table
 	//refer to the project documentation for the detailed steps
 
-	//allocate one page for the page table
-	uint32* pageTable = (uint32*) kmalloc(PAGE_SIZE);
+	//allocate one page for the page table (already zeroed by the cache)
+	uint32* pageTable = (uint32*) kmem_cache_alloc(page_table_cache);
 
 	//get frame info
 //	uint32* ptr = NULL;
@@ -584,15 +875,14 @@ void * create_page_table(uint32 *ptr_page_directory, const uint32 virtual_addres
 
 void __static_cpt(uint32 *ptr_page_directory, const uint32 virtual_address, uint32 **ptr_page_table)
 {
+	//the new page table is initialized by 0's
 	struct Frame_Info* ptr_new_frame_info;
-	int err = allocate_frame(&ptr_new_frame_info) ;
+	int err = allocate_zeroed_frame(&ptr_new_frame_info) ;
 
 	uint32 phys_page_table = to_physical_address(ptr_new_frame_info);
 	*ptr_page_table = STATIC_KERNEL_VIRTUAL_ADDRESS(phys_page_table) ;
 	ptr_new_frame_info->references = 1;
 	ptr_page_directory[PDX(virtual_address)] = CONSTRUCT_ENTRY(phys_page_table, PERM_PRESENT | PERM_USER | PERM_WRITEABLE);
-	//initialize new page table by 0's
-	memset(*ptr_page_table , 0, PAGE_SIZE);
 	tlbflush();
 }
 //
@@ -727,8 +1017,6 @@ void unmap_frame(uint32 *ptr_page_directory, void *virtual_address)
 	struct Frame_Info* ptr_frame_info = get_frame_info(ptr_page_directory, virtual_address, &ptr_page_table);
 	if( ptr_frame_info != 0 )
 	{
-		if (ptr_frame_info->isBuffered && !CHECK_IF_KERNEL_ADDRESS((uint32)virtual_address))
-			cprintf("Freeing BUFFERED frame at va %x!!!\n", virtual_address) ;
 		decrement_references(ptr_frame_info);
 		ptr_page_table[PTX(virtual_address)] = 0;
 		tlb_invalidate(ptr_page_directory, virtual_address);
@@ -788,6 +1076,174 @@ int loadtime_map_frame(uint32 *ptr_page_directory, struct Frame_Info *ptr_frame_
 }
 
 
+//
+// Map all the pages of [virtual_address, virtual_address + size) in one pass.
+// The page table is looked up once per 4 MB and its entries are filled in a
+// tight loop; the TLB is flushed once at the end, only if a mapping is replaced.
+//
+// Details
+//   - If kernel_source_address is 0, a new frame is allocated for each page,
+//     otherwise each page shares the frame mapped at the same offset from
+//     kernel_source_address (kernel tables are shared by all directories),
+//     pages with no frame mapped at the source are skipped.
+//   - Frames mapped in the kernel heap keep their (latest) virtual address (kheap_va).
+//   - If necessary, on demand, allocates the page tables.
+//   - The references of the mapped frames are incremented.
+//
+// RETURNS:
+//   0 on success
+//   E_NO_MEM if a frame can't be allocated (the pages mapped by this call are unmapped)
+//
+int map_frame_range(uint32 *ptr_page_directory, uint32 virtual_address, uint32 size, uint32 kernel_source_address, int perm)
+{
+	return __map_frame_range(ptr_page_directory, virtual_address, size, kernel_source_address, perm, 0);
+}
+
+//
+// Same as map_frame_range() with new frames, but the new frames are zeroed
+// (they are taken from the zeroed frames pool when possible).
+//
+int map_zeroed_frame_range(uint32 *ptr_page_directory, uint32 virtual_address, uint32 size, int perm)
+{
+	return __map_frame_range(ptr_page_directory, virtual_address, size, 0, perm, 1);
+}
+
+int __map_frame_range(uint32 *ptr_page_directory, uint32 virtual_address, uint32 size, uint32 kernel_source_address, int perm, int zeroed)
+{
+	uint32 va = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	uint32 src = ROUNDDOWN(kernel_source_address, PAGE_SIZE);
+	uint32 pages = (ROUNDUP(virtual_address + size, PAGE_SIZE) - va) / PAGE_SIZE;
+	uint32 mapped = 0;
+	int replaced = 0;
+
+	while (mapped < pages)
+	{
+		//the pages of this call in the current table (of both the destination and the source)
+		uint32 n = NPTENTRIES - PTX(va);
+		if (src != 0 && NPTENTRIES - PTX(src) < n)
+			n = NPTENTRIES - PTX(src);
+		if (pages - mapped < n)
+			n = pages - mapped;
+
+		uint32 *ptr_page_table;
+		if (get_page_table(ptr_page_directory, (void*)va, &ptr_page_table) == TABLE_NOT_EXIST)
+		{
+			if(USE_KHEAP)
+				ptr_page_table = create_page_table(ptr_page_directory, va);
+			else
+				__static_cpt(ptr_page_directory, va, &ptr_page_table);
+		}
+		uint32 *ptr_source_table = NULL;
+		if (src != 0)
+			get_page_table(ptr_page_directory, (void*)src, &ptr_source_table);
+
+		uint32 i;
+		for (i = 0; i < n; i++, va += PAGE_SIZE, src += (src != 0 ? PAGE_SIZE : 0))
+		{
+			struct Frame_Info *ptr_frame_info;
+			if (src != 0)
+			{
+				//nothing to share
+				if (ptr_source_table[PTX(src)] == 0)
+					continue;
+				ptr_frame_info = to_frame_info(EXTRACT_ADDRESS(ptr_source_table[PTX(src)]));
+			}
+			else if ((zeroed ? allocate_zeroed_frame(&ptr_frame_info) : allocate_frame(&ptr_frame_info)) == E_NO_MEM)
+			{
+				uint32 rollback;
+				for (rollback = ROUNDDOWN(virtual_address, PAGE_SIZE); rollback < va; rollback += PAGE_SIZE)
+					unmap_frame(ptr_page_directory, (void*)rollback);
+				return E_NO_MEM;
+			}
+
+			if (va >= KERNEL_HEAP_START)
+				ptr_frame_info->kheap_va = va;
+			ptr_frame_info->references++;
+
+			//drop the frame it replaces
+			uint32 page_table_entry = ptr_page_table[PTX(va)];
+			if ((page_table_entry & PERM_PRESENT) == PERM_PRESENT)
+			{
+				decrement_references(to_frame_info(EXTRACT_ADDRESS(page_table_entry)));
+				replaced = 1;
+			}
+			ptr_page_table[PTX(va)] = CONSTRUCT_ENTRY(to_physical_address(ptr_frame_info), perm | PERM_PRESENT);
+		}
+		mapped += n;
+	}
+
+	if (replaced)
+		tlbflush();
+
+	return 0;
+}
+
+//
+// Unmaps all the pages of [virtual_address, virtual_address + size).
+//
+// Details:
+//   - The page tables are walked once per 4 MB, missing tables are skipped.
+//   - The references of the unmapped frames are decremented in the same pass
+//     (kernel heap frames forget their virtual address if it is this one).
+//   - The TLB is invalidated once at the end: page by page for up to
+//     UNMAP_INVLPG_MAX pages, otherwise by a full flush.
+//
+// RETURNS:
+//   the number of unmapped pages
+//
+uint32 unmap_range(uint32 *ptr_page_directory, uint32 virtual_address, uint32 size)
+{
+	uint32 va = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	uint32 pages = (ROUNDUP(virtual_address + size, PAGE_SIZE) - va) / PAGE_SIZE;
+	uint32 invalidate[UNMAP_INVLPG_MAX];
+	uint32 unmapped = 0;
+
+	while (pages > 0)
+	{
+		//the pages of this call in the current table
+		uint32 n = NPTENTRIES - PTX(va);
+		if (pages < n)
+			n = pages;
+
+		uint32 *ptr_page_table = NULL;
+		if (ptr_page_directory[PDX(va)] != 0)
+			get_page_table(ptr_page_directory, (void*)va, &ptr_page_table);
+
+		uint32 i;
+		for (i = 0; ptr_page_table != NULL && i < n; i++)
+		{
+			uint32 page_va = va + i * PAGE_SIZE;
+			uint32 page_table_entry = ptr_page_table[PTX(page_va)];
+			if (page_table_entry == 0)
+				continue;
+
+			struct Frame_Info *ptr_frame_info = to_frame_info(EXTRACT_ADDRESS(page_table_entry));
+			if (ptr_frame_info->kheap_va == page_va)
+				ptr_frame_info->kheap_va = 0;
+			decrement_references(ptr_frame_info);
+			ptr_page_table[PTX(page_va)] = 0;
+
+			if (unmapped < UNMAP_INVLPG_MAX)
+				invalidate[unmapped] = page_va;
+			unmapped++;
+		}
+
+		va += n * PAGE_SIZE;
+		pages -= n;
+	}
+
+	if (unmapped > UNMAP_INVLPG_MAX)
+		tlbflush();
+	else
+	{
+		uint32 i;
+		for (i = 0; i < unmapped; i++)
+			tlb_invalidate(ptr_page_directory, (void*)invalidate[i]);
+	}
+
+	return unmapped;
+}
+
 ///****************************************************************************************///
 ///******************************* END OF MAPPING USER SPACE ******************************///
 ///****************************************************************************************///
@@ -805,19 +1261,51 @@ void allocateMem(struct Env* e, uint32 virtual_address, uint32 size)
 	// Write your code here, remove the panic and write your code
 	//panic("allocateMem() is not implemented yet...!!");
 
-	//allocate the required size in the page file on the hard disk
-	uint32 va;
-	for(va = virtual_address; va < virtual_address + size; va += PAGE_SIZE)
-		//allocate page on the page file
-		if(pf_add_empty_env_page(e, va, 0))
-			//no engough space
-			panic("ERROR: No enough virtual space on the page file");
+	if(__allocateMem(e, virtual_address, size))
+		//no engough space
+		panic("ERROR: No enough virtual space on the page file");
 
 	//This function should allocate ALL pages of the required range in the PAGE FILE
 	//and allocate NOTHING in the main memory
 
 }
 
+//allocateMem() that returns E_NO_MEM instead of panicking if the page file has no space for the
+//range (nothing of the range is allocated then)
+int __allocateMem(struct Env* e, uint32 virtual_address, uint32 size)
+{
+	uint32 pages = ROUNDUP(size, PAGE_SIZE) / PAGE_SIZE;
+	if(pages == 0)
+		return 0;
+
+	//the range becomes a zero-fill region: its pages get a zeroed frame at their first access
+	//and a page file slot at their first eviction, only their slots are reserved here
+	struct AnonRegion* region = anon_region_new(virtual_address, virtual_address + pages * PAGE_SIZE);
+	if(region != NULL){
+		if(pf_reserve_frames(pages)){
+			LIST_INSERT_HEAD(&freeAnonRegions, region);
+			return E_NO_MEM;
+		}
+		LIST_INSERT_HEAD(&e->anon_regions, region);
+		e->anon_reserved_pages += pages;
+
+		//create the disk tables of the range now, so an eviction only takes its reserved slot
+		pf_add_env_page_tables(e, virtual_address, size);
+		return 0;
+	}
+
+	//no free region nodes, allocate the required size in the page file on the hard disk
+	//(zeroed like the pages of a region, calloc() relies on it)
+	uint32 va;
+	for(va = virtual_address; va < virtual_address + size; va += PAGE_SIZE)
+		//allocate page on the page file
+		if(pf_add_empty_env_page(e, va, 1)){
+			pf_remove_env_page_range(e, virtual_address, va - virtual_address);
+			return E_NO_MEM;
+		}
+	return 0;
+}
+
 
 // [2] freeMem
 
@@ -832,24 +1320,16 @@ void freeMem(struct Env* e, uint32 virtual_address, uint32 size)
 	//2. Free ONLY pages that are resident in the working set from the memory
 	//3. Removes ONLY the empty page tables (i.e. not used) (no pages are mapped in the table)
 
-	//first remove all pages from the page file
-	uint32 va;
-	for(va = virtual_address; va < virtual_address + size; va += PAGE_SIZE)
-		//remove the page from the page file
-		pf_remove_env_page(e, va);
+	//first remove the zero-fill regions of the range (with their page file slots),
+	//then the rest of the range from the page file, one disk table at a time
+	env_anon_region_remove(e, virtual_address, virtual_address + size);
+	pf_remove_env_page_range(e, virtual_address, size);
 
-	//then remove all the active pages in the working set
-	int i;
-	for(i = 0; i < e->page_WS_max_size; i++)
-		//check the virtual address of the page in the ws entry
-		if(e->ptr_pageWorkingSet[i].virtual_address >= virtual_address
-				&& e->ptr_pageWorkingSet[i].virtual_address < virtual_address + size){
-			//first remove it from the memory
-			unmap_frame(e->env_page_directory, (void*) e->ptr_pageWorkingSet[i].virtual_address);
-
-			//then remove the page from the working set and update the working set
-			env_page_ws_clear_entry(e, (uint32) i);
-		}
+	//then remove all the active pages of the range from the working set
+	env_page_ws_remove_range(e, virtual_address, size);
+
+	//and from the memory, table by table
+	unmap_range(e->env_page_directory, virtual_address, size);
 
 	//finally remove the empty page files from the memory if exist
 	freeEnvPageTables(e, virtual_address, size);
@@ -858,50 +1338,64 @@ void freeMem(struct Env* e, uint32 virtual_address, uint32 size)
 }
 
 void __freeMem_with_buffering(struct Env* e, uint32 virtual_address, uint32 size) {
-
+	//the buffered pages of the range are not in the working set, their frames are freed first
+	//(a modified one is not written), then the range is freed as without buffering
+	unbuffer_env_range(e, virtual_address, size);
+	freeMem(e, virtual_address, size);
 }
 
 //my helper functions
 void freeEnvPageTables(struct Env* e, uint32 virtualAddress, uint32 size) {
 	//first remove the page tables that map only the given size
+	int freed = 0;
 	uint32 va;
 	for (va = ROUNDUP(virtualAddress, PAGE_SIZE * 1024); va < ROUNDDOWN(virtualAddress + size, PAGE_SIZE * 1024);
 			va += PAGE_SIZE * 1024) {
 		//free and unmap the 4MB page table if exist and update the directory
-		freePageTable(e, va);
+		freed |= freePageTable(e, va);
 	}
 
 	//now we need to check if we can remove the last two page tables or not
 	//first the upper 4MB
 	if (va < virtualAddress + size) {
 		//check if we can remove this page table exist or not
-		if (checkPageTable(e, va)) {
+		if (checkPageTable(e, va, virtualAddress, size)) {
 			//then we can remove this page table
-			freePageTable(e, va);
+			freed |= freePageTable(e, va);
 		}
 	}
 	//then the down 4MB
 	if(virtualAddress < ROUNDUP(virtualAddress, PAGE_SIZE * 1024)){
 		//check if we can remove this page table or not
-		if(checkPageTable(e, ROUNDDOWN(virtualAddress, PAGE_SIZE * 1024))){
+		if(checkPageTable(e, ROUNDDOWN(virtualAddress, PAGE_SIZE * 1024), virtualAddress, size)){
 			//then we can remove this page table
-			freePageTable(e, ROUNDDOWN(virtualAddress, PAGE_SIZE * 1024));
+			freed |= freePageTable(e, ROUNDDOWN(virtualAddress, PAGE_SIZE * 1024));
 		}
 	}
 
-	tlbflush();
+	//the pages are already invalidated by unmap_range(), flush only for the removed tables
+	if(freed)
+		tlbflush();
 }
 
-int checkPageTable(struct Env* e, uint32 virtualAddress) {
+int checkPageTable(struct Env* e, uint32 virtualAddress, uint32 freedAddress, uint32 freedSize) {
 	//check if the last page table exist or not
 	uint32* pageTableVA = NULL;
 	get_page_table(e->env_page_directory, (void*) virtualAddress, &pageTableVA);
 	if (pageTableVA == NULL)
 		return 0;
 
+	//the entries of the freed range are already cleared, only the other entries are checked
+	uint32 tableStart = ROUNDDOWN(virtualAddress, PAGE_SIZE * 1024);
+	uint32 freedStart = ROUNDDOWN(freedAddress, PAGE_SIZE), freedEnd = ROUNDUP(freedAddress + freedSize, PAGE_SIZE);
+	int from = freedStart > tableStart ? (freedStart - tableStart) / PAGE_SIZE : 0;
+	int to = freedEnd < tableStart + PAGE_SIZE * 1024 ? (freedEnd - tableStart) / PAGE_SIZE : 1024;
+
 	//then there is one last page table, we need to check first if we can remove it or not
 	int i;
 	for (i = 0; i < 1024; i++) {
+		if (i == from) i = to;
+		if (i == 1024) break;
 		//check if it maps a page not belong to the removable size
 		/*struct Frame_Info* frameInfo = NULL;
 		 frameInfo = get_frame_info(e->env_page_directory, (void*) va, &pageTableVA);*/
@@ -914,14 +1408,17 @@ int checkPageTable(struct Env* e, uint32 virtualAddress) {
 	return 1;
 
 }
-void freePageTable(struct Env* e, uint32 virtualAddress) {
+int freePageTable(struct Env* e, uint32 virtualAddress) {
 	//first get the virtual address of that page table
 	uint32* pageTableVA = NULL;
 	get_page_table(e->env_page_directory, (void*) virtualAddress, &pageTableVA);
 	if (pageTableVA == NULL)
-		return;
+		return 0;
 
 	kfree(pageTableVA);
+	//the directory must not point to the released table
+	e->env_page_directory[PDX(virtualAddress)] = 0;
+	return 1;
 
 	/*
 	//page table is a kernel virtual address, then we can get it's physical address
@@ -939,6 +1436,121 @@ void freePageTable(struct Env* e, uint32 virtualAddress) {
 	*/
 }
 
+//======================================================
+/// zero-fill-on-demand regions
+//======================================================
+
+//the region nodes of all environments, the released nodes are kept in a free list
+struct AnonRegion anonRegions[MAX_ANON_REGIONS];
+struct AnonRegion_List freeAnonRegions;
+uint32 newAnonRegions = 0;	//nodes after it are never used
+
+struct AnonRegion* anon_region_new(uint32 start, uint32 end)
+{
+	struct AnonRegion* region = LIST_FIRST(&freeAnonRegions);
+	if(region != NULL)
+		LIST_REMOVE(&freeAnonRegions, region);
+	else if(newAnonRegions < MAX_ANON_REGIONS)
+		region = &anonRegions[newAnonRegions++];
+	else
+		return NULL;
+
+	region->start = start;
+	region->end = end;
+	return region;
+}
+
+//the region holding the given virtual address, NULL if it is not in a zero-fill region
+struct AnonRegion* env_anon_region_lookup(struct Env* e, uint32 virtual_address)
+{
+	struct AnonRegion* region;
+	LIST_FOREACH(region, &e->anon_regions)
+		if(virtual_address >= region->start && virtual_address < region->end)
+			return region;
+	return NULL;
+}
+
+//returns 1 if a region of the env has pages in the range [start, end)
+int env_anon_region_overlaps(struct Env* e, uint32 start, uint32 end)
+{
+	struct AnonRegion* region;
+	LIST_FOREACH(region, &e->anon_regions)
+		if(region->start < end && region->end > start)
+			return 1;
+	return 0;
+}
+
+//remove the range [start, end) from the regions of the env, the pages of the range are removed
+//from the page file and the pages that have no slot give back their reserved slots
+void env_anon_region_remove(struct Env* e, uint32 start, uint32 end)
+{
+	struct AnonRegion* region = LIST_FIRST(&e->anon_regions);
+	while(region != NULL){
+		struct AnonRegion* next = LIST_NEXT(region);
+		if(region->end <= start || region->start >= end){
+			region = next;
+			continue;
+		}
+
+		uint32 from = region->start > start ? region->start : start;
+		uint32 to = region->end < end ? region->end : end;
+		uint32 backed = pf_remove_env_page_range(e, from, to - from);
+		env_anon_unreserve_pages(e, (to - from) / PAGE_SIZE - backed);
+
+		if(region->start >= start && region->end <= end){
+			//the whole region is removed
+			LIST_REMOVE(&e->anon_regions, region);
+			LIST_INSERT_HEAD(&freeAnonRegions, region);
+		}
+		else if(region->start < start && region->end > end){
+			//the range is in the middle of the region, split it
+			struct AnonRegion* rest = anon_region_new(end, region->end);
+			if(rest != NULL)
+				LIST_INSERT_HEAD(&e->anon_regions, rest);
+			else
+				//no free region nodes, the pages after the range take their slots now
+				env_anon_region_populate(e, end, region->end);
+			region->end = start;
+		}
+		else if(region->start < start)
+			region->end = start;
+		else
+			region->start = end;
+
+		region = next;
+	}
+}
+
+//give the pages of [start, end) that have no slot their reserved page file slots,
+//the new slots are zeroed as the pages of the region would be
+void env_anon_region_populate(struct Env* e, uint32 start, uint32 end)
+{
+	uint32 va;
+	for(va = start; va < end; va += PAGE_SIZE){
+		if(pf_env_page_exists(e, va)) continue;
+		env_anon_unreserve_pages(e, 1);
+		if(pf_add_empty_env_page(e, va, 1))
+			panic("ERROR: No enough virtual space on the page file");
+	}
+}
+
+void env_anon_unreserve_pages(struct Env* e, uint32 pages)
+{
+	e->anon_reserved_pages -= pages;
+	pf_unreserve_frames(pages);
+}
+
+//release all regions of the env with their reserved slots
+void env_anon_regions_free(struct Env* e)
+{
+	struct AnonRegion* region;
+	while((region = LIST_FIRST(&e->anon_regions)) != NULL){
+		LIST_REMOVE(&e->anon_regions, region);
+		LIST_INSERT_HEAD(&freeAnonRegions, region);
+	}
+	env_anon_unreserve_pages(e, e->anon_reserved_pages);
+}
+
 //================= [BONUS] =====================
 // [3] moveMem
 
@@ -946,12 +1558,308 @@ void moveMem(struct Env* e, uint32 src_virtual_address, uint32 dst_virtual_addre
 {
 	//TODO: [PROJECT 2016 - BONUS4] realloc() [Kernel Side]
 	//your code is here, remove the panic and write your code
-	panic("moveMem() is not implemented yet...!!");
+	//panic("moveMem() is not implemented yet...!!");
 
 	// This function should move all pages from "src_virtual_address" to "dst_virtual_address"
 	// with the given size
 	// After finished, the src_virtual_address must no longer be accessed/exist in either page file
 	// or main memory
+
+	//the pages are moved by their entries, their contents are not copied
+	//(the destination range is a new allocation, it has no pages in the main memory)
+	uint32 offset;
+	for(offset = 0; offset < size; offset += PAGE_SIZE){
+		//move the page file entry
+		uint32 va = dst_virtual_address + offset;
+		int backed = pf_env_page_exists(e, va);
+		pf_move_env_page(e, src_virtual_address + offset, va);
+
+		//a page that brings its slot into a zero-fill region no longer needs the slot
+		//the region reserved for it (see env_anon_region_remove())
+		if(!backed && pf_env_page_exists(e, va) && env_anon_region_lookup(e, va) != NULL)
+			env_anon_unreserve_pages(e, 1);
+	}
+
+	//move the working set entries
+	int i;
+	for(i = 0; i < e->page_WS_max_size; i++)
+		if(!e->ptr_pageWorkingSet[i].empty && e->ptr_pageWorkingSet[i].virtual_address >= src_virtual_address
+				&& e->ptr_pageWorkingSet[i].virtual_address < src_virtual_address + size)
+			e->ptr_pageWorkingSet[i].virtual_address += dst_virtual_address - src_virtual_address;
+
+	//and the page table entries, table by table
+	uint32 src = src_virtual_address, dst = dst_virtual_address;
+	uint32 pages = ROUNDUP(size, PAGE_SIZE) / PAGE_SIZE, moved = 0;
+	while(moved < pages){
+		//the pages of the current source and destination tables
+		uint32 n = NPTENTRIES - PTX(src);
+		if(NPTENTRIES - PTX(dst) < n) n = NPTENTRIES - PTX(dst);
+		if(pages - moved < n) n = pages - moved;
+
+		uint32 *ptr_src_table, *ptr_dst_table = NULL;
+		if(get_page_table(e->env_page_directory, (void*) src, &ptr_src_table) == TABLE_IN_MEMORY){
+			uint32 j;
+			for(j = 0; j < n; j++){
+				uint32 entry = ptr_src_table[PTX(src + j * PAGE_SIZE)];
+				if(entry == 0) continue;
+
+				uint32 va = dst + j * PAGE_SIZE;
+				if(ptr_dst_table == NULL && get_page_table(e->env_page_directory, (void*) va, &ptr_dst_table) == TABLE_NOT_EXIST){
+					if(USE_KHEAP)
+						ptr_dst_table = create_page_table(e->env_page_directory, va);
+					else
+						__static_cpt(e->env_page_directory, va, &ptr_dst_table);
+				}
+				ptr_dst_table[PTX(va)] = entry;
+				ptr_src_table[PTX(src + j * PAGE_SIZE)] = 0;
+
+				//a buffered page remembers its virtual address
+				struct Frame_Info* ptr_frame_info = to_frame_info(EXTRACT_ADDRESS(entry));
+				if(ptr_frame_info->isBuffered && ptr_frame_info->environment == e)
+					ptr_frame_info->va = va;
+			}
+		}
+		src += n * PAGE_SIZE;
+		dst += n * PAGE_SIZE;
+		moved += n;
+	}
+	tlbflush();
+
+	//finally remove the source page tables that became empty
+	freeEnvPageTables(e, src_virtual_address, size);
+}
+
+// [4] prefaultMem
+//	Loads the pages of the given range to the working set in one call (up to its free entries),
+//	so the first accesses to the range don't fault page by page. The pages of the zero-fill
+//	regions take zeroed frames, the pages of the page file are read by multi-sector transfers.
+
+void prefaultMem(struct Env* e, uint32 virtual_address, uint32 size)
+{
+	uint32 freeEntries = e->page_WS_max_size - env_page_ws_get_size(e);
+	uint32 entry = e->page_last_WS_index % e->page_WS_max_size;
+
+	//the page file pages of the range are read by runs of consecutive pages
+	uint32 runStart = 0, runPages = 0;
+
+	uint32 va = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	uint32 end = ROUNDUP(virtual_address + size, PAGE_SIZE);
+	for(; va < end && freeEntries > 0; va += PAGE_SIZE){
+		//a buffered page is given back without reading it
+		if(isBufferingEnabled() && reclaim_buffered_page(e, va)){
+			while(!e->ptr_pageWorkingSet[entry].empty)
+				entry = (entry + 1) % e->page_WS_max_size;
+			env_page_ws_set_entry(e, entry, va);
+			entry = (entry + 1) % e->page_WS_max_size;
+			freeEntries--;
+			continue;
+		}
+
+		//skip the pages in memory and the pages that are not allocated
+		uint32 *ptr_page_table;
+		if(get_frame_info(e->env_page_directory, (void*) va, &ptr_page_table) != NULL)
+			continue;
+		int inPageFile = pf_env_page_exists(e, va);
+		if(!inPageFile && env_anon_region_lookup(e, va) == NULL)
+			continue;
+
+		//leave some free frames for the page tables of the kernel
+		if(LIST_SIZE(&free_frame_list) + LIST_SIZE(&zeroed_frame_list) < PREFAULT_RESERVED_FRAMES)
+			break;
+
+		struct Frame_Info* ptr_frame_info = NULL;
+		if(inPageFile)
+			allocate_frame(&ptr_frame_info);
+		else
+			allocate_zeroed_frame(&ptr_frame_info);
+		map_frame(e->env_page_directory, ptr_frame_info, (void*) va, PERM_PRESENT | PERM_USER | PERM_WRITEABLE);
+
+		if(inPageFile){
+			if(runPages > 0 && runStart + runPages * PAGE_SIZE != va){
+				pf_read_env_pages(e, runStart, runPages);
+				runPages = 0;
+			}
+			if(runPages == 0)
+				runStart = va;
+			runPages++;
+		}
+
+		//the page takes the next empty entry of the working set
+		while(!e->ptr_pageWorkingSet[entry].empty)
+			entry = (entry + 1) % e->page_WS_max_size;
+		env_page_ws_set_entry(e, entry, va);
+		entry = (entry + 1) % e->page_WS_max_size;
+		freeEntries--;
+	}
+	if(runPages > 0)
+		pf_read_env_pages(e, runStart, runPages);
+
+	//the placement takes the entry at the last index, so it must be an empty one
+	uint32 i;
+	for(i = 0; freeEntries > 0 && i < e->page_WS_max_size && !e->ptr_pageWorkingSet[entry].empty; i++)
+		entry = (entry + 1) % e->page_WS_max_size;
+	e->page_last_WS_index = entry;
+}
+
+// [5] adviseMem
+//	Applies the given access hint to the range: WILLNEED loads its pages now, DONTNEED drops its
+//	allocated pages without writing them back (they come back zeroed) and RANDOM or SEQUENTIAL are
+//	kept for the range and used by the page fault handler. The range must start on a page boundary
+//	and must not be empty. Returns 0 or E_INVAL / E_NO_MEM.
+
+int adviseMem(struct Env* e, uint32 virtual_address, uint32 size, uint32 advice)
+{
+	if(size == 0 || virtual_address % PAGE_SIZE != 0)
+		return E_INVAL;
+	uint32 start = virtual_address;
+	uint32 end = ROUNDUP(virtual_address + size, PAGE_SIZE);
+
+	switch(advice)
+	{
+	case MADV_NORMAL:
+	case MADV_RANDOM:
+	case MADV_SEQUENTIAL:
+		return env_advice_set(e, start, end, advice);
+	case MADV_WILLNEED:
+		prefaultMem(e, start, end - start);
+		return 0;
+	case MADV_DONTNEED:
+		//only the user heap can be dropped
+		if(start < USER_HEAP_START || end > USER_HEAP_MAX)
+			return E_INVAL;
+		return env_drop_allocated(e, start, end);
+	}
+	return E_INVAL;
+}
+
+// [6] trimMem
+//	Releases the page tables and the disk page tables of the 4 MB spans inside the range that have
+//	no pages (neither mapped, nor in the page file, nor reserved by a zero-fill region), the user
+//	heap calls it for its large free blocks. Returns the number of released tables or E_INVAL.
+
+int trimMem(struct Env* e, uint32 virtual_address, uint32 size)
+{
+	if(virtual_address < USER_HEAP_START || virtual_address >= USER_HEAP_MAX || size > USER_HEAP_MAX - virtual_address)
+		return E_INVAL;
+
+	int released = 0, freed = 0;
+	uint32 va;
+	for(va = ROUNDUP(virtual_address, PTSIZE); va + PTSIZE <= virtual_address + size; va += PTSIZE)
+	{
+		//a zero-fill region keeps the disk table of its reserved slots
+		if(env_anon_region_overlaps(e, va, va + PTSIZE))
+			continue;
+
+		//all the entries of the page table are checked (no freed range)
+		uint32* pageTableVA = NULL;
+		get_page_table(e->env_page_directory, (void*) va, &pageTableVA);
+		if(pageTableVA != NULL){
+			if(!checkPageTable(e, va, va, 0))
+				continue;
+			freePageTable(e, va);
+			freed = 1;
+			released++;
+		}
+
+		//the span has no pages, so its table is not in the page file anymore
+		__pf_remove_env_table(e, va);
+		released += pf_remove_env_page_table(e, va);
+	}
+
+	if(freed)
+		tlbflush();
+	return released;
+}
+
+//drop the allocated pages of [start, end) (in a zero-fill region or in the page file): each run of
+//them is freed then allocated again, so it gets zero-fill pages with their reserved slots.
+//Returns E_NO_MEM if a run can't be allocated again
+int env_drop_allocated(struct Env* e, uint32 start, uint32 end)
+{
+	uint32 va, runStart = start;
+	for(va = start; va <= end; va += PAGE_SIZE){
+		if(va < end && (env_anon_region_lookup(e, va) != NULL || pf_env_page_exists(e, va)))
+			continue;
+
+		//the run ends before va
+		if(runStart < va){
+			if(isBufferingEnabled())
+				__freeMem_with_buffering(e, runStart, va - runStart);
+			else
+				freeMem(e, runStart, va - runStart);
+			if(__allocateMem(e, runStart, va - runStart))
+				return E_NO_MEM;
+		}
+		runStart = va + PAGE_SIZE;
+	}
+	return 0;
+}
+
+//set the hint of the range [start, end) in the hints of the env (MADV_NORMAL removes the hints of
+//the range), the hints of the other ranges are trimmed. Returns E_NO_MEM if there is no free entry
+int env_advice_set(struct Env* e, uint32 start, uint32 end, uint32 advice)
+{
+	int i;
+	struct MemAdvice* freeEntry = NULL;
+	if(e->mem_advices == NULL){
+		if(advice == MADV_NORMAL || start >= end)
+			return 0;
+		//the table is a small kernel object, it takes a slot of the kmalloc-256 class not a frame
+		e->mem_advices = kmalloc(MAX_MEM_ADVICES * sizeof(struct MemAdvice));
+		if(e->mem_advices == NULL)
+			return E_NO_MEM;
+		memset(e->mem_advices, 0, MAX_MEM_ADVICES * sizeof(struct MemAdvice));
+	}
+	for(i = 0; i < MAX_MEM_ADVICES; i++){
+		struct MemAdvice* entry = &e->mem_advices[i];
+		if(entry->advice != MADV_NORMAL && entry->start < end && entry->end > start){
+			if(entry->start < start && entry->end > end){
+				//the range is inside the entry, its upper part takes a free entry (if any)
+				int j;
+				for(j = 0; j < MAX_MEM_ADVICES; j++)
+					if(e->mem_advices[j].advice == MADV_NORMAL){
+						e->mem_advices[j] = *entry;
+						e->mem_advices[j].start = end;
+						break;
+					}
+				entry->end = start;
+			}
+			else if(entry->start < start)
+				entry->end = start;
+			else if(entry->end > end)
+				entry->start = end;
+			else
+				entry->advice = MADV_NORMAL;
+		}
+	}
+
+	if(advice == MADV_NORMAL || start >= end)
+		return 0;
+
+	for(i = 0; i < MAX_MEM_ADVICES && freeEntry == NULL; i++)
+		if(e->mem_advices[i].advice == MADV_NORMAL)
+			freeEntry = &e->mem_advices[i];
+	if(freeEntry == NULL)
+		return E_NO_MEM;
+
+	freeEntry->start = start;
+	freeEntry->end = end;
+	freeEntry->advice = advice;
+	freeEntry->last_fault = start;
+	return 0;
+}
+
+//returns the hint entry of the given address or NULL if it has no hint
+struct MemAdvice* env_advice_lookup(struct Env* e, uint32 virtual_address)
+{
+	int i;
+	if(e->mem_advices == NULL)
+		return NULL;
+	for(i = 0; i < MAX_MEM_ADVICES; i++)
+		if(e->mem_advices[i].advice != MADV_NORMAL && virtual_address >= e->mem_advices[i].start
+				&& virtual_address < e->mem_advices[i].end)
+			return &e->mem_advices[i];
+	return NULL;
 }
 
 //==================================================================================================
@@ -1050,6 +1958,9 @@ struct freeFramesCounters calculate_available_frames()
 
 
 
+	//the zeroed frames and the blocks of contiguous frames are free (not buffered) frames too
+	totalFreeUnBuffered += LIST_SIZE(&zeroed_frame_list) + frame_buddy_free_frames();
+
 	LIST_FOREACH(ptr, &modified_frame_list)
 	{
 		totalModified++ ;
@@ -1060,6 +1971,8 @@ struct freeFramesCounters calculate_available_frames()
 	counters.freeBuffered = totalFreeBuffered ;
 	counters.freeNotBuffered = totalFreeUnBuffered ;
 	counters.modified = totalModified;
+	counters.cached = kmem_cache_idle_frames();
+	counters.zeroed = LIST_SIZE(&zeroed_frame_list);
 	return counters;
 }
 
@@ -1095,11 +2008,55 @@ inline void env_page_ws_set_entry(struct Env* e, uint32 entry_index, uint32 virt
 	e->ptr_pageWorkingSet[entry_index].virtual_address = ROUNDDOWN(virtual_address,PAGE_SIZE);
 	e->ptr_pageWorkingSet[entry_index].empty = 0;
 
+	//the frame of the page keeps the index of its entry (see env_page_ws_remove_range())
+	uint32 *ptr_page_table;
+	struct Frame_Info* ptr_frame_info = get_frame_info(e->env_page_directory, (void*) virtual_address, &ptr_page_table);
+	if (ptr_frame_info != NULL)
+		ptr_frame_info->ws_index = entry_index;
+
 	e->ptr_pageWorkingSet[entry_index].time_stamp = 0x80000000;
 	//e->ptr_pageWorkingSet[entry_index].time_stamp = time;
 	return;
 }
 
+//clear the working set entries of the resident pages of the given range, the page tables of the range
+//give the frames of its pages and each frame gives the index of its entry
+void env_page_ws_remove_range(struct Env* e, uint32 virtual_address, uint32 size)
+{
+	uint32 va = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	uint32 end = ROUNDUP(virtual_address + size, PAGE_SIZE);
+	while (va < end)
+	{
+		//the pages of the range in the current table
+		uint32 n = NPTENTRIES - PTX(va);
+		if ((end - va) / PAGE_SIZE < n)
+			n = (end - va) / PAGE_SIZE;
+
+		uint32 *ptr_page_table = NULL;
+		if (e->env_page_directory[PDX(va)] != 0)
+			get_page_table(e->env_page_directory, (void*)va, &ptr_page_table);
+
+		uint32 i;
+		for (i = 0; ptr_page_table != NULL && i < n; i++)
+		{
+			uint32 page_table_entry = ptr_page_table[PTX(va) + i];
+			if (!(page_table_entry & PERM_PRESENT))
+				continue;
+
+			uint32 page_va = va + i * PAGE_SIZE;
+			uint32 entry_index = to_frame_info(EXTRACT_ADDRESS(page_table_entry))->ws_index;
+			if (entry_index < e->page_WS_max_size && !e->ptr_pageWorkingSet[entry_index].empty
+					&& e->ptr_pageWorkingSet[entry_index].virtual_address == page_va)
+				env_page_ws_clear_entry(e, entry_index);
+			else
+				//the page is not placed through env_page_ws_set_entry(), search for it
+				env_page_ws_invalidate(e, page_va);
+		}
+
+		va += n * PAGE_SIZE;
+	}
+}
+
 inline void env_page_ws_clear_entry(struct Env* e, uint32 entry_index)
 {
 	assert(entry_index >= 0 && entry_index < (e->page_WS_max_size));
@@ -1327,6 +2284,129 @@ void bufferlist_remove_page(struct Linked_List* bufferList, struct Frame_Info *p
 	LIST_REMOVE(bufferList, ptr_frame_info);
 }
 
+//keep the evicted page of the env in its frame, its entry keeps the frame but it's not present:
+//a clean page goes to the tail of the free frames (its frame is given after the other free frames)
+//and a modified page goes to the modified buffer that is written when it's full.
+//A modified page must have its slot in the page file
+void buffer_env_page(struct Env* e, uint32 virtual_address)
+{
+	uint32 *ptr_page_table;
+	struct Frame_Info* ptr_frame_info = get_frame_info(e->env_page_directory, (void*) virtual_address, &ptr_page_table);
+	if (ptr_frame_info == NULL)
+		return;
+
+	virtual_address = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	uint32 entry = ptr_page_table[PTX(virtual_address)];
+	ptr_frame_info->references = 0;
+	ptr_frame_info->isBuffered = 1;
+	ptr_frame_info->environment = e;
+	ptr_frame_info->va = virtual_address;
+	ptr_page_table[PTX(virtual_address)] = (entry & ~PERM_PRESENT) | PERM_BUFFERED;
+	tlb_invalidate(e->env_page_directory, (void*) virtual_address);
+
+	if ((entry & PERM_MODIFIED) && isModifiedBufferEnabled())
+	{
+		bufferList_add_page(&modified_frame_list, ptr_frame_info);
+		if (LIST_SIZE(&modified_frame_list) >= getModifiedBufferLength())
+			flush_modified_buffer();
+		return;
+	}
+
+	//without the modified buffer a modified page is written now
+	if (entry & PERM_MODIFIED)
+	{
+		pf_update_env_page(e, (void*) virtual_address, ptr_frame_info);
+		ptr_page_table[PTX(virtual_address)] &= ~PERM_MODIFIED;
+	}
+	bufferList_add_page(&free_frame_list, ptr_frame_info);
+}
+
+//write the pages of the modified buffer to the page file, they stay buffered as clean pages
+//at the tail of the free frames
+void flush_modified_buffer()
+{
+	struct Frame_Info *ptr_frame_info;
+	while ((ptr_frame_info = LIST_FIRST(&modified_frame_list)) != NULL)
+	{
+		bufferlist_remove_page(&modified_frame_list, ptr_frame_info);
+		pf_update_env_page(ptr_frame_info->environment, (void*) ptr_frame_info->va, ptr_frame_info);
+		pt_set_page_permissions(ptr_frame_info->environment, ptr_frame_info->va, 0, PERM_MODIFIED);
+		bufferList_add_page(&free_frame_list, ptr_frame_info);
+	}
+}
+
+//give the buffered page of the env at the given address back to it without reading it from the
+//page file (the caller gives it a working set entry), returns 0 if the page is not buffered
+int reclaim_buffered_page(struct Env* e, uint32 virtual_address)
+{
+	uint32 *ptr_page_table = NULL;
+	if (e->env_page_directory[PDX(virtual_address)] != 0)
+		get_page_table(e->env_page_directory, (void*) virtual_address, &ptr_page_table);
+	if (ptr_page_table == NULL)
+		return 0;
+
+	uint32 entry = ptr_page_table[PTX(virtual_address)];
+	if ((entry & PERM_PRESENT) || !(entry & PERM_BUFFERED))
+		return 0;
+
+	//a modified page is still in the modified buffer (it's not written yet)
+	struct Frame_Info* ptr_frame_info = to_frame_info(EXTRACT_ADDRESS(entry));
+	if (entry & PERM_MODIFIED)
+		bufferlist_remove_page(&modified_frame_list, ptr_frame_info);
+	else
+		bufferlist_remove_page(&free_frame_list, ptr_frame_info);
+	initialize_frame_info(ptr_frame_info);
+	ptr_frame_info->references = 1;
+	ptr_page_table[PTX(virtual_address)] = (entry & ~PERM_BUFFERED) | PERM_PRESENT;
+	return 1;
+}
+
+//free the frames of the buffered pages of the range without writing them
+void unbuffer_env_range(struct Env* e, uint32 virtual_address, uint32 size)
+{
+	uint32 va = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	uint32 end = ROUNDUP(virtual_address + size, PAGE_SIZE);
+	while (va < end)
+	{
+		//the pages of the range in the current table
+		uint32 n = NPTENTRIES - PTX(va);
+		if ((end - va) / PAGE_SIZE < n)
+			n = (end - va) / PAGE_SIZE;
+
+		uint32 *ptr_page_table = NULL;
+		if (e->env_page_directory[PDX(va)] != 0)
+			get_page_table(e->env_page_directory, (void*) va, &ptr_page_table);
+
+		uint32 i;
+		for (i = 0; ptr_page_table != NULL && i < n; i++)
+		{
+			uint32 page_va = va + i * PAGE_SIZE;
+			if ((ptr_page_table[PTX(page_va)] & PERM_BUFFERED) && reclaim_buffered_page(e, page_va))
+				unmap_frame(e->env_page_directory, (void*) page_va);
+		}
+		va += n * PAGE_SIZE;
+	}
+}
+
+//write the modified buffer and give the buffered frames back as free frames (the pages are
+//read again at their next fault), it's done when the buffering is turned off
+void release_buffered_frames()
+{
+	flush_modified_buffer();
+
+	//the buffered frames are at the tail of the free frames
+	struct Frame_Info *ptr_frame_info = LIST_LAST(&free_frame_list);
+	while (ptr_frame_info != NULL && ptr_frame_info->isBuffered)
+	{
+		pt_clear_page_table_entry(ptr_frame_info->environment, ptr_frame_info->va);
+		ptr_frame_info->isBuffered = 0;
+		ptr_frame_info->environment = NULL;
+		ptr_frame_info->va = 0;
+		ptr_frame_info = LIST_PREV(ptr_frame_info);
+	}
+	tlbflush();
+}
+
 
 
 ///============================================================================================
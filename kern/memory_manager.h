@@ -41,6 +41,10 @@ uint32 isUHeapPlacementStrategyWORSTFIT();
 struct freeFramesCounters
 {
 	int freeBuffered, freeNotBuffered, modified;
+	//frames of free kernel cache objects, they are reclaimed on demand
+	int cached;
+	//free frames already zeroed (counted in freeNotBuffered)
+	int zeroed;
 };
 
 struct Env;
@@ -50,6 +54,8 @@ extern char ptr_stack_top[], ptr_stack_bottom[];
 extern struct Frame_Info* frames_info;
 extern struct Frame_Info* disk_frames_info;		// Virtual address of physical frames_info array
 extern struct Linked_List free_frame_list;	// Free list of physical frames
+extern struct Linked_List zeroed_frame_list;	// Free frames that are already zeroed
+extern uint32 zeroedFrameHits, zeroedFrameMisses;
 extern struct Linked_List modified_frame_list;	// Free list of physical frames
 extern uint32 number_of_frames;
 
@@ -69,6 +75,29 @@ void	initialize_kernel_VM();
 void	initialize_paging();
 int allocate_frame(struct Frame_Info **ptr_frame_info);
 void free_frame(struct Frame_Info *ptr_frame_info);
+
+//blocks of 2^order physically contiguous frames (up to 4 MB)
+#define FRAME_BUDDY_MAX_ORDER	10
+extern struct Linked_List frame_buddy_lists[];
+int allocate_frames(struct Frame_Info **ptr_frame_info, uint32 order);
+void free_frames(struct Frame_Info *ptr_frame_info, uint32 order);
+void coalesce_free_frames();
+uint32 frame_buddy_free_frames();
+struct Frame_Info* remove_free_frame();
+void frame_buddy_insert(struct Frame_Info *ptr_frame_info, uint32 order);
+struct Frame_Info* frame_buddy_remove(uint32 order);
+void frame_buddy_push(struct Frame_Info *ptr_frame_info, uint32 order);
+void frame_buddy_unlink(struct Frame_Info *ptr_frame_info, uint32 order);
+
+//zeroed frames pool: refilled when there is nothing to run (up to ZEROED_FRAMES_TARGET)
+//and by free_frame() while it is under ZEROED_FRAMES_LOW
+#define ZEROED_FRAMES_TARGET	64
+#define ZEROED_FRAMES_LOW	16
+//kernel page used to zero a frame, it is just below the kernel heap (not used by the kernel)
+#define ZERO_FRAME_WINDOW	(KERNEL_HEAP_START - PAGE_SIZE)
+int allocate_zeroed_frame(struct Frame_Info **ptr_frame_info);
+void zero_frame(struct Frame_Info *ptr_frame_info);
+uint32 refill_zeroed_frames(uint32 target);
 int get_page_table(uint32 *ptr_page_directory, const void *virtual_address, uint32 **ptr_page_table);
 
 //2016
@@ -76,6 +105,12 @@ void * create_page_table(uint32 *ptr_page_directory, const uint32 virtual_addres
 
 int	map_frame(uint32 *ptr_page_directory, struct Frame_Info *ptr_frame_info, void *virtual_address, int perm);
 void	unmap_frame(uint32 *pgdir, void *va);
+int	map_frame_range(uint32 *ptr_page_directory, uint32 virtual_address, uint32 size, uint32 kernel_source_address, int perm);
+int	map_zeroed_frame_range(uint32 *ptr_page_directory, uint32 virtual_address, uint32 size, int perm);
+int	__map_frame_range(uint32 *ptr_page_directory, uint32 virtual_address, uint32 size, uint32 kernel_source_address, int perm, int zeroed);
+//unmap_range() invalidates up to this number of pages one by one, more pages flush the whole TLB
+#define UNMAP_INVLPG_MAX 32
+uint32	unmap_range(uint32 *ptr_page_directory, uint32 virtual_address, uint32 size);
 struct Frame_Info *get_frame_info(uint32 *ptr_page_directory, void *virtual_address, uint32 **ptr_page_table);
 void decrement_references(struct Frame_Info* ptr_frame_info);
 void initialize_frame_info(struct Frame_Info *ptr_frame_info);
@@ -100,7 +135,28 @@ static inline struct Frame_Info* to_frame_info(uint32 physical_address)
 
 void freeMem(struct Env* e, uint32 virtual_address, uint32 size);
 void allocateMem(struct Env* e, uint32 virtual_address, uint32 size);
+int __allocateMem(struct Env* e, uint32 virtual_address, uint32 size);
 void moveMem(struct Env* e, uint32 src_virtual_address, uint32 dst_virtual_address, uint32 size);
+//frames left free by prefaultMem() for the page tables
+#define PREFAULT_RESERVED_FRAMES	16
+void prefaultMem(struct Env* e, uint32 virtual_address, uint32 size);
+int adviseMem(struct Env* e, uint32 virtual_address, uint32 size, uint32 advice);
+int trimMem(struct Env* e, uint32 virtual_address, uint32 size);
+int env_advice_set(struct Env* e, uint32 start, uint32 end, uint32 advice);
+int env_drop_allocated(struct Env* e, uint32 start, uint32 end);
+struct MemAdvice* env_advice_lookup(struct Env* e, uint32 virtual_address);
+//pages loaded after a fault in a SEQUENTIAL range
+#define READ_AHEAD_PAGES	8
+
+//zero-fill-on-demand regions of the user heap
+#define MAX_ANON_REGIONS 4096
+struct AnonRegion* anon_region_new(uint32 start, uint32 end);
+struct AnonRegion* env_anon_region_lookup(struct Env* e, uint32 virtual_address);
+int env_anon_region_overlaps(struct Env* e, uint32 start, uint32 end);
+void env_anon_region_remove(struct Env* e, uint32 start, uint32 end);
+void env_anon_region_populate(struct Env* e, uint32 start, uint32 end);
+void env_anon_unreserve_pages(struct Env* e, uint32 pages);
+void env_anon_regions_free(struct Env* e);
 uint32 calculate_required_frames(uint32* ptr_page_directory, uint32 start_virtual_address, uint32 size);
 struct freeFramesCounters calculate_available_frames();
 void trim_all_environments();
@@ -111,6 +167,7 @@ inline uint32 env_page_ws_get_size(struct Env *e);
 inline void env_page_ws_invalidate(struct Env* e, uint32 virtual_address);
 inline void env_page_ws_set_entry(struct Env* e, uint32 entry_index, uint32 virtual_address);
 inline void env_page_ws_clear_entry(struct Env* e, uint32 entry_index);
+void env_page_ws_remove_range(struct Env* e, uint32 virtual_address, uint32 size);
 inline uint32 env_page_ws_get_virtual_address(struct Env* e, uint32 entry_index);
 inline uint32 env_page_ws_get_time_stamp(struct Env* e, uint32 entry_index);
 inline uint32 env_page_ws_is_entry_empty(struct Env* e, uint32 entry_index);
@@ -120,6 +177,11 @@ void env_page_ws_print(struct Env *curenv);
 //page buffering functions
 void bufferList_add_page(struct Linked_List* bufferList, struct Frame_Info *ptr_frame_info);
 void bufferlist_remove_page(struct Linked_List* bufferList, struct Frame_Info *ptr_frame_info);
+void buffer_env_page(struct Env* e, uint32 virtual_address);
+void flush_modified_buffer();
+int reclaim_buffered_page(struct Env* e, uint32 virtual_address);
+void unbuffer_env_range(struct Env* e, uint32 virtual_address, uint32 size);
+void release_buffered_frames();
 
 
 //Page tables entries
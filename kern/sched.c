@@ -63,7 +63,11 @@ fos_scheduler(void)
 		scheduler_status = SCH_STOPPED;
 		//cprintf("[sched] no envs - nothing more to do!\n");
 		while (1)
+		{
+			//nothing to run, zero free frames for the coming page tables and pages
+			refill_zeroed_frames(ZEROED_FRAMES_TARGET);
 			run_command_prompt(NULL);
+		}
 
 	}
 }
@@ -14,6 +14,7 @@
 #include <kern/semaphore_manager.h>
 #include <kern/shared_memory_manager.h>
 #include <kern/sched.h>
+#include <kern/uheap_trace.h>
 
 extern uint32 isBufferingEnabled();
 extern void __freeMem_with_buffering(struct Env* e, uint32 virtual_address, uint32 size);
@@ -136,8 +137,9 @@ static int __sys_allocate_page(void *va, int perm)
 	//if ((r = envid2env(envid, &e, 1)) < 0)
 	//return r;
 
+	//the new page is initialized by 0's
 	struct Frame_Info *ptr_frame_info ;
-	r = allocate_frame(&ptr_frame_info) ;
+	r = allocate_zeroed_frame(&ptr_frame_info) ;
 	if (r == E_NO_MEM)
 		return r ;
 
@@ -150,29 +152,6 @@ static int __sys_allocate_page(void *va, int perm)
 		return E_INVAL;
 
 
-	uint32 physical_address = to_physical_address(ptr_frame_info) ;
-
-	if(USE_KHEAP)
-	{
-		//FIX: we should implement a better solution for this, but for now
-			//		we are using an unsed VA in the invalid area of kernel at 0xef800000 (the current USER_LIMIT)
-			//		to do temp initialization of a frame.
-		map_frame(e->env_page_directory, ptr_frame_info, (void*)USER_LIMIT, PERM_WRITEABLE);
-		memset((void*)USER_LIMIT, 0, PAGE_SIZE);
-
-		// Temporarily increase the references to prevent unmap_frame from removing the frame
-		// we just got from allocate_frame, we will use it for the new page
-		ptr_frame_info->references += 1;
-		unmap_frame(e->env_page_directory, (void*)USER_LIMIT);
-
-		//return it to the original status
-		ptr_frame_info->references -= 1;
-	}
-	else
-	{
-		memset(STATIC_KERNEL_VIRTUAL_ADDRESS(physical_address), 0, PAGE_SIZE);
-	}
-
 	r = map_frame(e->env_page_directory, ptr_frame_info, va, perm) ;
 	if (r == E_NO_MEM)
 	{
@@ -236,7 +215,7 @@ uint32 sys_calculate_free_frames()
 {
 	struct freeFramesCounters counters = calculate_available_frames();
 	//	cprintf("Free Frames = %d : Buffered = %d, Not Buffered = %d\n", counters.freeBuffered + counters.freeNotBuffered, counters.freeBuffered ,counters.freeNotBuffered);
-	return counters.freeBuffered + counters.freeNotBuffered;
+	return counters.freeBuffered + counters.freeNotBuffered + counters.cached;
 
 }
 uint32 sys_calculate_modified_frames()
@@ -268,12 +247,17 @@ void sys_freeMem(uint32 virtual_address, uint32 size)
 	{
 		freeMem(curenv, virtual_address, size);
 	}
+	//the freed range loses its access hints
+	env_advice_set(curenv, virtual_address, virtual_address + size, MADV_NORMAL);
 	return;
 }
 
-void sys_allocateMem(uint32 virtual_address, uint32 size)
+void sys_allocateMem(uint32 virtual_address, uint32 size, uint32 prefault)
 {
 	allocateMem(curenv, virtual_address, size);
+	//load the pages now instead of at their first accesses
+	if(prefault)
+		prefaultMem(curenv, virtual_address, size);
 	return;
 }
 
@@ -289,7 +273,7 @@ void sys_enable_interrupt()
 
 void sys_clearFFL()
 {
-	int size = LIST_SIZE(&free_frame_list) ;
+	int size = LIST_SIZE(&free_frame_list) + LIST_SIZE(&zeroed_frame_list) + frame_buddy_free_frames() ;
 	int i = 0 ;
 	struct Frame_Info* ptr_tmp_FI ;
 	for (; i < size ; i++)
@@ -453,6 +437,32 @@ void sys_set_uheap_strategy(uint32 heapStrategy)
 	_UHeapPlacementStrategy = heapStrategy;
 }
 
+//record the given heap call of the current env (if the tracing is on), the event NULL only asks
+//if the tracing is on
+int sys_uheap_trace(struct uheapTraceEvent* event)
+{
+	if(event == NULL)
+		return isUHeapTracingEnabled();
+	if((uint32) event >= USER_TOP)
+		return 0;
+	struct uheapTraceEvent copy = *event;
+	return uheap_trace_record(curenv, &copy);
+}
+
+int sys_madvise(uint32 virtual_address, uint32 size, uint32 advice)
+{
+	if(virtual_address >= USER_TOP || size > USER_TOP - virtual_address)
+		return E_INVAL;
+	return adviseMem(curenv, virtual_address, size, advice);
+}
+
+int sys_trimMem(uint32 virtual_address, uint32 size)
+{
+	if(virtual_address >= USER_TOP || size > USER_TOP - virtual_address)
+		return E_INVAL;
+	return trimMem(curenv, virtual_address, size);
+}
+
 
 // Dispatches to the correct kernel function, passing the arguments.
 uint32 syscall(uint32 syscallno, uint32 a1, uint32 a2, uint32 a3, uint32 a4, uint32 a5)
@@ -514,7 +524,7 @@ uint32 syscall(uint32 syscallno, uint32 a1, uint32 a2, uint32 a3, uint32 a4, uin
 		break;
 	case SYS_allocateMem:
 		//LOG_STATMENT(cprintf("KERNEL syscall: a2 %x\n", a2));
-		sys_allocateMem(a1, (uint32)a2);
+		sys_allocateMem(a1, (uint32)a2, (uint32)a3);
 		return 0;
 		break;
 	case SYS_disableINTR:
@@ -627,6 +637,15 @@ uint32 syscall(uint32 syscallno, uint32 a1, uint32 a2, uint32 a3, uint32 a4, uin
 		sys_set_uheap_strategy(a1);
 		return 0;
 
+	case SYS_madvise:
+		return sys_madvise(a1, a2, a3);
+
+	case SYS_uheap_trace:
+		return sys_uheap_trace((struct uheapTraceEvent*) a1);
+
+	case SYS_trimMem:
+		return sys_trimMem(a1, a2);
+
 	case NSYSCALLS:
 		return 	-E_INVAL;
 		break;
@@ -2,6 +2,8 @@
 #include <kern/kheap.h>
 #include <kern/memory_manager.h>
 #include <inc/queue.h>
+#include <kern/kclock.h>
+#include <kern/kmem_cache.h>
 
 #define Mega  (1024*1024)
 #define kilo (1024)
@@ -1052,3 +1054,479 @@ int test_three_creation_functions()
 
 	return 1;
 }
+
+//Measure the cost of kheap_virtual_address (used by get_page_table on every
+//user page fault) while the kernel heap grows. The cost should stay flat.
+int test_kheap_virt_addr_time()
+{
+	uint32 sizes[] = {1*Mega, 4*Mega, 16*Mega};
+	int numOfSizes = sizeof(sizes)/sizeof(sizes[0]);
+	int numOfLookups = 1000;
+	void* ptr_allocations[3] = {0};
+	int i, j;
+
+	cprintf("heap size\tavg cycles per kheap_virtual_address\n");
+	for (i = 0; i < numOfSizes; ++i)
+	{
+		ptr_allocations[i] = kmalloc(sizes[i]);
+		if (ptr_allocations[i] == NULL) panic("Failed to allocate the benchmark block");
+
+		//look up the frame of the last page in the heap, the worst case for a heap scan
+		uint32 lastVA = (uint32)ptr_allocations[i] + sizes[i] - PAGE_SIZE;
+		uint32 pa = kheap_physical_address(lastVA);
+
+		struct uint64 start = get_virtual_time();
+		for (j = 0; j < numOfLookups; ++j)
+		{
+			if (kheap_virtual_address(pa) != lastVA)
+				panic("Wrong kheap_virtual_address");
+		}
+		struct uint64 end = get_virtual_time();
+
+		cprintf("%d KB\t\t%d\n", (lastVA + PAGE_SIZE - KERNEL_HEAP_START)/kilo, (end.low - start.low)/numOfLookups);
+	}
+
+	for (i = 0; i < numOfSizes; ++i)
+		kfree(ptr_allocations[i]);
+
+	cprintf("Congratulations!! test kheap_virtual_address time completed successfully.\n");
+
+	return 1;
+}
+
+//Check the kernel heap placement strategies and the coalescing of freed extents
+int test_kheap_placement()
+{
+	uint32 oldStrategy = _KHeapPlacementStrategy;
+	void* ptr_allocations[8] = {0};
+	uint32 pages[8] = {4, 1, 2, 1, 8, 1, 3, 1};
+	int i;
+
+	//lay out blocks continuously then free every other one to leave
+	//holes of 4, 2, 8 and 3 pages separated by 1-page blocks
+	setKHeapPlacementStrategyCONTINUOUS();
+	for (i = 0; i < 8; ++i)
+	{
+		ptr_allocations[i] = kmalloc(pages[i]*PAGE_SIZE);
+		if (ptr_allocations[i] == NULL) panic("Failed to allocate the placement test blocks");
+	}
+	uint32 base = (uint32)ptr_allocations[0];
+	for (i = 0; i < 8; ++i)
+	{
+		if ((uint32)ptr_allocations[i] != base) panic("Wrong start address for the allocated space... CONTINUOUS allocation is not continuous");
+		base += pages[i]*PAGE_SIZE;
+	}
+	base = (uint32)ptr_allocations[0];
+	for (i = 0; i < 8; i += 2)
+		kfree(ptr_allocations[i]);
+
+	//FIRST FIT takes the first hole
+	setKHeapPlacementStrategyFIRSTFIT();
+	void* ptr = kmalloc(2*PAGE_SIZE);
+	if ((uint32)ptr != base) panic("Wrong FIRST FIT placement");
+	kfree(ptr);
+
+	//BEST FIT takes the smallest hole that fits
+	setKHeapPlacementStrategyBESTFIT();
+	ptr = kmalloc(2*PAGE_SIZE);
+	if ((uint32)ptr != base + 5*PAGE_SIZE) panic("Wrong BEST FIT placement");
+	void* ptr2 = kmalloc(3*PAGE_SIZE);
+	if ((uint32)ptr2 != base + 17*PAGE_SIZE) panic("Wrong BEST FIT placement");
+	kfree(ptr);
+	kfree(ptr2);
+	cprintf("kheap placement: current evaluation = 40%");
+
+	//NEXT FIT continues from the end of the last allocation
+	void* ptr_next[5] = {0};
+	setKHeapPlacementStrategyFIRSTFIT();
+	ptr_next[0] = kmalloc(PAGE_SIZE);
+	setKHeapPlacementStrategyNEXTFIT();
+	ptr_next[1] = kmalloc(2*PAGE_SIZE);
+	ptr_next[2] = kmalloc(2*PAGE_SIZE);
+	ptr_next[3] = kmalloc(2*PAGE_SIZE);
+	ptr_next[4] = kmalloc(6*PAGE_SIZE);
+	if ((uint32)ptr_next[0] != base) panic("Wrong FIRST FIT placement");
+	if ((uint32)ptr_next[1] != base + 1*PAGE_SIZE) panic("Wrong NEXT FIT placement");
+	if ((uint32)ptr_next[2] != base + 5*PAGE_SIZE) panic("Wrong NEXT FIT placement");
+	if ((uint32)ptr_next[3] != base + 8*PAGE_SIZE) panic("Wrong NEXT FIT placement");
+	if ((uint32)ptr_next[4] != base + 10*PAGE_SIZE) panic("Wrong NEXT FIT placement");
+
+	//the allocated pages are usable
+	for (i = 0; i < 5; ++i)
+	{
+		*((int*)ptr_next[i]) = i;
+		if (*((int*)ptr_next[i]) != i) panic("Wrong allocation: stored values are wrongly changed!");
+	}
+	cprintf("\b\b\b70%");
+
+	//free everything, the freed extents must coalesce into one extent
+	int freeFrames = sys_calculate_free_frames() ;
+	for (i = 0; i < 5; ++i)
+		kfree(ptr_next[i]);
+	for (i = 1; i < 8; i += 2)
+		kfree(ptr_allocations[i]);
+	if ((sys_calculate_free_frames() - freeFrames) != 1+2+2+2+6+4) panic("Wrong kfree: pages in memory are not freed correctly");
+
+	setKHeapPlacementStrategyFIRSTFIT();
+	ptr = kmalloc(21*PAGE_SIZE);
+	if ((uint32)ptr != base) panic("Wrong kfree: freed extents are not coalesced");
+	kfree(ptr);
+
+	_KHeapPlacementStrategy = oldStrategy;
+
+	cprintf("\b\b\b100%\n");
+	cprintf("Congratulations!! test kheap placement completed successfully.\n");
+
+	return 1;
+}
+
+//Check that freed cache objects are reused without mapping new frames
+int test_kmem_cache()
+{
+	struct kmem_cache* cache = kmem_cache_lookup("test_cache", 2*PAGE_SIZE, kmem_zero_ctor);
+	if (cache == NULL) panic("Failed to create the test cache");
+	kmem_cache_reap();
+
+	//a new object is allocated from the kernel heap and constructed
+	int freeFrames = sys_calculate_free_frames() ;
+	int* obj = kmem_cache_alloc(cache);
+	if (obj == NULL) panic("Failed to allocate a cache object");
+	if ((freeFrames - sys_calculate_free_frames()) != 2) panic("Wrong allocation: cache object is not loaded into memory");
+	if (obj[0] != 0 || obj[2*PAGE_SIZE/sizeof(int) - 1] != 0) panic("Cache constructor is not applied");
+	obj[0] = 10;
+
+	//kfree gives it back to its cache, still mapped but counted as available
+	kfree(obj);
+	if (sys_calculate_free_frames() != freeFrames) panic("Wrong kfree: cached frames are not counted as available");
+	if (kheap_physical_address((uint32)obj) == 0) panic("Wrong kfree: cached object is unmapped");
+
+	//the next allocation reuses the same object, constructed again
+	int* obj2 = kmem_cache_alloc(cache);
+	if (obj2 != obj) panic("Freed cache object is not reused");
+	if (obj2[0] != 0) panic("Cache constructor is not applied on free");
+	cprintf("kmem_cache: current evaluation = 60%");
+
+	//reaping gives the idle frames back to the free frame list
+	kmem_cache_free(cache, obj2);
+	if (kmem_cache_reap() != 2) panic("Wrong reap: idle frames are not released");
+	if (kheap_physical_address((uint32)obj) != 0) panic("Wrong reap: idle object is still mapped");
+	if (sys_calculate_free_frames() != freeFrames) panic("Wrong reap: frames are not freed correctly");
+
+	cprintf("\b\b\b100%\n");
+	cprintf("Congratulations!! test kmem_cache completed successfully.\n");
+
+	return 1;
+}
+
+//Check that small kmalloc requests share pages while page-sized ones keep their own pages
+int test_kmalloc_small()
+{
+	void* ptr_allocations[64] = {0};
+	int i, j;
+	kmem_cache_reap();
+
+	//64 objects of 64 bytes fit in one frame
+	int freeFrames = sys_calculate_free_frames() ;
+	for (i = 0; i < 64; ++i)
+	{
+		ptr_allocations[i] = kmalloc(60);
+		if (ptr_allocations[i] == NULL) panic("Failed to allocate a small object");
+		if ((uint32)ptr_allocations[i] % 64 != 0) panic("Wrong allocation: small object is not aligned to its size class");
+		memset(ptr_allocations[i], i, 60);
+	}
+	if ((freeFrames - sys_calculate_free_frames()) > 2) panic("Wrong allocation: small objects do not share their frames");
+	for (i = 0; i < 64; ++i)
+		for (j = 0; j < 60; ++j)
+			if (((char*)ptr_allocations[i])[j] != i) panic("Wrong allocation: small objects overlap");
+	cprintf("kmalloc small: current evaluation = 50%");
+
+	//2 KB is still page granular
+	freeFrames = sys_calculate_free_frames() ;
+	void* ptr = kmalloc(2*kilo);
+	if ((uint32)ptr % PAGE_SIZE != 0) panic("Wrong allocation: page sized requests should start at a page");
+	if ((freeFrames - sys_calculate_free_frames()) != 1) panic("Wrong allocation: pages are not loaded successfully into memory");
+	kfree(ptr);
+
+	//freeing all objects gives their frames back
+	for (i = 0; i < 64; ++i)
+		kfree(ptr_allocations[i]);
+	kmem_cache_reap();
+	if (kheap_physical_address((uint32)ptr_allocations[0]) != 0) panic("Wrong kfree: empty slab is still mapped");
+
+	cprintf("\b\b\b100%\n");
+	cprintf("Congratulations!! test kmalloc small completed successfully.\n");
+
+	return 1;
+}
+
+//Check the buddy mode: naturally aligned blocks, splitting and merging
+int test_kheap_buddy()
+{
+	if (enableKHeapBuddy(1) != 0)
+	{
+		cprintf("the kernel heap is in use, run this test right after booting FOS\n");
+		return 0;
+	}
+
+	//the initial free blocks
+	uint32 freeBlocks[BUDDY_MAX_ORDER + 1];
+	int order;
+	for (order = 0; order <= BUDDY_MAX_ORDER; ++order)
+		freeBlocks[order] = buddyFreeBlocks(order);
+	if (freeBlocks[BUDDY_MAX_ORDER] != KHEAP_PAGES / (1 << BUDDY_MAX_ORDER)) panic("Wrong buddy initialization: the heap is not covered by the largest blocks");
+
+	//a 4 MB block is 4 MB aligned, only the requested pages of a block are mapped
+	int freeFrames = sys_calculate_free_frames() ;
+	void* ptr_allocations[4] = {0};
+	ptr_allocations[0] = kmalloc(4*1024*1024);
+	ptr_allocations[1] = kmalloc(5*PAGE_SIZE);
+	ptr_allocations[2] = kmalloc(PAGE_SIZE);
+	ptr_allocations[3] = kmalloc(4*1024*1024);
+	if ((uint32)ptr_allocations[0] != KERNEL_HEAP_START) panic("Wrong buddy placement");
+	if ((uint32)ptr_allocations[1] != KERNEL_HEAP_START + 4*1024*1024) panic("Wrong buddy placement");
+	if ((uint32)ptr_allocations[2] != KERNEL_HEAP_START + 4*1024*1024 + 8*PAGE_SIZE) panic("Wrong buddy placement: the block is not split");
+	if ((uint32)ptr_allocations[3] != KERNEL_HEAP_START + 8*1024*1024) panic("Wrong buddy placement");
+	if ((uint32)ptr_allocations[3] % (4*1024*1024) != 0) panic("Wrong buddy placement: the block is not naturally aligned");
+	if ((freeFrames - sys_calculate_free_frames()) != 1024+5+1+1024) panic("Wrong allocation: pages are not loaded successfully into memory");
+	cprintf("kheap buddy: current evaluation = 40%");
+
+	//the allocated pages are usable
+	int i;
+	for (i = 0; i < 4; ++i)
+	{
+		*((int*)ptr_allocations[i]) = i;
+		if (*((int*)ptr_allocations[i]) != i) panic("Wrong allocation: stored values are wrongly changed!");
+	}
+
+	//too large for the largest block
+	if (kmalloc((1 << BUDDY_MAX_ORDER)*PAGE_SIZE + PAGE_SIZE) != NULL) panic("Wrong buddy allocation: the block is larger than the largest order");
+	cprintf("\b\b\b70%");
+
+	//free everything, the blocks must merge back into the initial ones
+	for (i = 0; i < 4; ++i)
+		kfree(ptr_allocations[i]);
+	if ((sys_calculate_free_frames() - freeFrames) != 0) panic("Wrong kfree: pages in memory are not freed correctly");
+	for (order = 0; order <= BUDDY_MAX_ORDER; ++order)
+		if (buddyFreeBlocks(order) != freeBlocks[order]) panic("Wrong kfree: freed blocks are not merged with their buddies");
+
+	if (enableKHeapBuddy(0) != 0) panic("Wrong kfree: the kernel heap is not empty");
+
+	cprintf("\b\b\b100%\n");
+	cprintf("Congratulations!! test kheap buddy completed successfully.\n");
+
+	return 1;
+}
+
+//Compare the latency of mapping multi-megabyte kmalloc blocks page by page (map_frame)
+//and in one pass (map_frame_range, used by kmalloc)
+int test_kmalloc_map_time()
+{
+	uint32 sizes[] = {1*Mega, 4*Mega, 16*Mega};
+	int numOfSizes = sizeof(sizes)/sizeof(sizes[0]);
+	int i;
+	uint32 va;
+
+	cprintf("block size\tcycles per page (map_frame)\tcycles per page (map_frame_range)\n");
+	for (i = 0; i < numOfSizes; ++i)
+	{
+		uint32 pages = sizes[i] / PAGE_SIZE;
+
+		struct uint64 start = get_virtual_time();
+		void* ptr = kmalloc(sizes[i]);
+		struct uint64 end = get_virtual_time();
+		if (ptr == NULL) panic("Failed to allocate the benchmark block");
+		uint32 rangeCycles = (end.low - start.low) / pages;
+		kfree(ptr);
+
+		//the same pages mapped one by one (as kmalloc used to do) at the freed place
+		start = get_virtual_time();
+		for (va = (uint32)ptr; va < (uint32)ptr + sizes[i]; va += PAGE_SIZE)
+		{
+			struct Frame_Info* frameInfo = NULL;
+			allocate_frame(&frameInfo);
+			map_frame(ptr_page_directory, frameInfo, (void*)va, PERM_WRITEABLE | PERM_PRESENT);
+		}
+		end = get_virtual_time();
+		uint32 pageCycles = (end.low - start.low) / pages;
+		for (va = (uint32)ptr; va < (uint32)ptr + sizes[i]; va += PAGE_SIZE)
+			unmap_frame(ptr_page_directory, (void*)va);
+
+		cprintf("%d KB\t\t%d\t\t\t\t%d\n", sizes[i]/kilo, pageCycles, rangeCycles);
+	}
+
+	cprintf("Congratulations!! test kmalloc map time completed successfully.\n");
+
+	return 1;
+}
+
+//Check krealloc: grow and shrink in place, move without copying, small objects
+int test_krealloc()
+{
+	if (isKHeapBuddyEnabled())
+	{
+		cprintf("this test uses the CONTINUOUS placement, disable the buddy mode first (nokbuddy)\n");
+		return 0;
+	}
+	uint32 oldStrategy = _KHeapPlacementStrategy;
+	setKHeapPlacementStrategyCONTINUOUS();
+
+	//grow in place at the end of the heap, only the new pages are mapped
+	int freeFrames = sys_calculate_free_frames() ;
+	int* ptr = kmalloc(2*PAGE_SIZE);
+	if (ptr == NULL) panic("Failed to allocate the krealloc test block");
+	ptr[0] = 10;
+	ptr[PAGE_SIZE/sizeof(int)] = 20;
+	int* ptr2 = krealloc(ptr, 4*PAGE_SIZE);
+	if (ptr2 != ptr) panic("Wrong krealloc: the block is not extended in place");
+	if ((freeFrames - sys_calculate_free_frames()) != 4) panic("Wrong krealloc: only the new pages should be allocated");
+	ptr2[3*PAGE_SIZE/sizeof(int)] = 30;
+	cprintf("krealloc: current evaluation = 30%");
+
+	//the next pages are used, the block is moved and keeps its frames
+	void* block = kmalloc(PAGE_SIZE);
+	uint32 firstFrame = kheap_physical_address((uint32)ptr2);
+	int* ptr3 = krealloc(ptr2, 6*PAGE_SIZE);
+	if (ptr3 == NULL || ptr3 == ptr2) panic("Wrong krealloc: the block is not moved");
+	if ((freeFrames - sys_calculate_free_frames()) != 6+1) panic("Wrong krealloc: the data must be moved without new frames");
+	if (kheap_physical_address((uint32)ptr3) != firstFrame) panic("Wrong krealloc: the frames are not moved with the block");
+	if (kheap_virtual_address(firstFrame) != (uint32)ptr3) panic("Wrong krealloc: kheap_virtual_address of a moved frame");
+	if (kheap_physical_address((uint32)ptr2) != 0) panic("Wrong krealloc: the old block is still mapped");
+	if (ptr3[0] != 10 || ptr3[PAGE_SIZE/sizeof(int)] != 20 || ptr3[3*PAGE_SIZE/sizeof(int)] != 30) panic("Wrong krealloc: the data is not kept");
+	ptr3[5*PAGE_SIZE/sizeof(int)] = 50;
+	cprintf("\b\b\b60%");
+
+	//shrink in place, the tail frames are freed
+	int* ptr4 = krealloc(ptr3, PAGE_SIZE);
+	if (ptr4 != ptr3) panic("Wrong krealloc: the block is not shrunk in place");
+	if ((freeFrames - sys_calculate_free_frames()) != 1+1) panic("Wrong krealloc: the tail frames are not freed");
+	if (kheap_physical_address((uint32)ptr4 + PAGE_SIZE) != 0) panic("Wrong krealloc: the tail is still mapped");
+	if (ptr4[0] != 10) panic("Wrong krealloc: the data is not kept");
+
+	//small objects stay in their size class while they fit
+	char* small = kmalloc(20);
+	small[0] = 'a';
+	if (krealloc(small, 30) != small) panic("Wrong krealloc: the object fits in its size class");
+	char* small2 = krealloc(small, 100);
+	if (small2 == NULL || small2 == small || small2[0] != 'a') panic("Wrong krealloc: the small object is not moved with its data");
+
+	kfree(small2);
+	kfree(ptr4);
+	kfree(block);
+	kmem_cache_reap();
+	if ((freeFrames - sys_calculate_free_frames()) != 0) panic("Wrong kfree: pages in memory are not freed correctly");
+
+	_KHeapPlacementStrategy = oldStrategy;
+
+	cprintf("\b\b\b100%\n");
+	cprintf("Congratulations!! test krealloc completed successfully.\n");
+
+	return 1;
+}
+
+//Check kmalloc_reserve: no frames until the pages are touched, then zeroed frames on demand
+int test_kmalloc_reserve()
+{
+	int freeFrames = sys_calculate_free_frames() ;
+	char* ptr = kmalloc_reserve(4*Mega);
+	if (ptr == NULL) panic("Failed to reserve the test block");
+	if ((freeFrames - sys_calculate_free_frames()) != 0) panic("Wrong kmalloc_reserve: no frames should be allocated");
+	if (kheap_physical_address((uint32)ptr) != 0) panic("Wrong kmalloc_reserve: the pages should not be mapped");
+	cprintf("kmalloc reserve: current evaluation = 30%");
+
+	//the first access of a page maps a zeroed frame to it
+	if (ptr[100] != 0) panic("Wrong kernel heap fault: the page is not zeroed");
+	ptr[3*PAGE_SIZE + 5] = 'a';
+	ptr[4*Mega - 1] = 'b';
+	if ((freeFrames - sys_calculate_free_frames()) != 3) panic("Wrong kernel heap fault: only the touched pages should be mapped");
+	if (ptr[3*PAGE_SIZE + 5] != 'a' || ptr[4*Mega - 1] != 'b') panic("Wrong kernel heap fault: stored values are wrongly changed!");
+	if (kheap_physical_address((uint32)ptr + PAGE_SIZE) != 0) panic("Wrong kernel heap fault: untouched pages should not be mapped");
+	cprintf("\b\b\b70%");
+
+	//the touched pages are freed with the block
+	kfree(ptr);
+	if ((freeFrames - sys_calculate_free_frames()) != 0) panic("Wrong kfree: pages in memory are not freed correctly");
+	if (kheapLazyPages != 0) panic("Wrong kfree: the reserved pages are not released");
+
+	cprintf("\b\b\b100%\n");
+	cprintf("Congratulations!! test kmalloc reserve completed successfully.\n");
+
+	return 1;
+}
+
+int test_zeroed_frames()
+{
+	//zeroing the free frames doesn't change the number of free frames
+	int freeFrames = sys_calculate_free_frames() ;
+	refill_zeroed_frames(ZEROED_FRAMES_TARGET);
+	if (LIST_SIZE(&zeroed_frame_list) != ZEROED_FRAMES_TARGET) panic("Wrong refill: the zeroed frames pool is not filled");
+	if (sys_calculate_free_frames() != freeFrames) panic("Wrong refill: the zeroed frames should be counted as free frames");
+	cprintf("zeroed frames: current evaluation = 20%");
+
+	//zeroed blocks take their frames from the pool
+	uint32 hits = zeroedFrameHits;
+	char* ptr = kmalloc_zeroed(8*PAGE_SIZE);
+	if (ptr == NULL) panic("Failed to allocate the test block");
+	if (zeroedFrameHits - hits != 8 || LIST_SIZE(&zeroed_frame_list) != ZEROED_FRAMES_TARGET - 8) panic("Wrong kmalloc_zeroed: the frames are not taken from the pool");
+	int i;
+	for (i = 0; i < 8*PAGE_SIZE; i++)
+		if (ptr[i] != 0) panic("Wrong kmalloc_zeroed: the block is not zeroed");
+	cprintf("\b\b\b50%");
+
+	//take the whole pool, then the frames freed under the low watermark are zeroed and go to the pool
+	memset(ptr, 0xAB, 8*PAGE_SIZE);
+	struct Frame_Info* taken[ZEROED_FRAMES_TARGET];
+	int numOfTaken = 0;
+	while (LIST_SIZE(&zeroed_frame_list) > 0)
+		allocate_zeroed_frame(&taken[numOfTaken++]);
+	kfree(ptr);
+	if (LIST_SIZE(&zeroed_frame_list) != 8) panic("Wrong free_frame: the freed frames should refill the pool under its low watermark");
+	ptr = kmalloc_zeroed(8*PAGE_SIZE);
+	for (i = 0; i < 8*PAGE_SIZE; i++)
+		if (ptr[i] != 0) panic("Wrong free_frame: the frames of the pool are not zeroed");
+	kfree(ptr);
+	for (i = 0; i < numOfTaken; i++)
+		free_frame(taken[i]);
+	if (sys_calculate_free_frames() != freeFrames) panic("Wrong free_frame: frames are not freed correctly");
+
+	cprintf("\b\b\b100%\n");
+	cprintf("Congratulations!! test zeroed frames completed successfully.\n");
+
+	return 1;
+}
+
+int test_allocate_frames()
+{
+	int freeFrames = sys_calculate_free_frames() ;
+
+	//blocks of contiguous frames, aligned to their size
+	struct Frame_Info *block16, *block256, *frame;
+	if (allocate_frames(&block16, 4) != 0) panic("Failed to allocate 16 contiguous frames");
+	if (to_frame_number(block16) % 16 != 0) panic("Wrong allocate_frames: the block is not aligned to its size");
+	if (allocate_frames(&block256, 8) != 0) panic("Failed to allocate 256 contiguous frames");
+	if (to_frame_number(block256) % 256 != 0) panic("Wrong allocate_frames: the block is not aligned to its size");
+	if ((freeFrames - sys_calculate_free_frames()) != 16 + 256) panic("Wrong allocate_frames: wrong number of allocated frames");
+	if (to_frame_number(block16) + 16 > to_frame_number(block256) && to_frame_number(block256) + 256 > to_frame_number(block16))
+		panic("Wrong allocate_frames: the blocks overlap");
+	if (allocate_frames(&frame, FRAME_BUDDY_MAX_ORDER + 1) != E_NO_MEM) panic("Wrong allocate_frames: the order is larger than the max order");
+	cprintf("allocate frames: current evaluation = 40%");
+
+	//single frames are taken and given back as before
+	if (allocate_frame(&frame) != 0) panic("Failed to allocate a frame");
+	if ((freeFrames - sys_calculate_free_frames()) != 16 + 256 + 1) panic("Wrong allocate_frame: wrong number of allocated frames");
+	if ((frame >= block16 && frame < block16 + 16) || (frame >= block256 && frame < block256 + 256))
+		panic("Wrong allocate_frame: the frame is in an allocated block");
+	free_frame(frame);
+	cprintf("\b\b\b70%");
+
+	//the freed blocks merge back with their free buddies
+	free_frames(block16, 4);
+	free_frames(block256, 8);
+	if ((freeFrames - sys_calculate_free_frames()) != 0) panic("Wrong free_frames: frames are not freed correctly");
+	if (allocate_frames(&block256, 8) != 0) panic("Wrong free_frames: the freed block is not available again");
+	free_frames(block256, 8);
+
+	cprintf("\b\b\b100%\n");
+	cprintf("Congratulations!! test allocate frames completed successfully.\n");
+
+	return 1;
+}
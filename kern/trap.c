@@ -11,6 +11,7 @@
 #include <kern/syscall.h>
 #include <kern/sched.h>
 #include <kern/kclock.h>
+#include <kern/kheap.h>
 #include <kern/trap.h>
 
 //my helper functions
@@ -20,6 +21,10 @@ void placement(struct Env* e, uint32 faultedVA);
 void removePage(struct Env* e, int victimPageIndex);
 void LRUreplacement(struct Env* e, uint32 faultedVA);
 void CLOCKreplacement(struct Env* e, uint32 faultedVA);
+int zeroPageCopyOnWrite(struct Env* e, uint32 faultedVA);
+int findVictimPageBehind(struct Env* e);
+int findVictimPage(struct Env* e);
+void readAhead(struct Env* e, struct MemAdvice* advice, uint32 faultedVA);
 
 
 extern void __static_cpt(uint32 *ptr_page_directory,
@@ -35,6 +40,9 @@ static struct Taskstate ts;
 // 0 means don't bypass the PAGE FAULT
 uint8 bypassInstrLength = 0;
 
+//the current page fault is caused by a write (set by fault_handler() for placement())
+uint8 faultIsWrite = 1;
+
 /// Interrupt descriptor table.  (Must be built at run time because
 /// shifted function addresses can't be represented in relocation records.)
 ///
@@ -253,6 +261,13 @@ void trap(struct Trapframe *tf) {
 				env_pop_tf(tf);
 			}
 		}
+
+		//the kernel touched a reserved kernel heap page, map it and go back to the kernel
+		if (!userTrap && rcr2() >= KERNEL_HEAP_START && rcr2() < KERNEL_HEAP_MAX) {
+			fault_handler(tf);
+			kclock_resume();
+			env_pop_tf(tf);
+		}
 	}
 	trap_dispatch(tf);
 	assert(curenv && curenv->env_status == ENV_READY);
@@ -307,6 +322,13 @@ uint32 isBufferingEnabled() {
 	return _EnableBuffering;
 }
 
+void enableZeroPageSharing(uint32 enableIt) {
+	_EnableZeroPageSharing = enableIt;
+}
+uint32 isZeroPageSharingEnabled() {
+	return _EnableZeroPageSharing;
+}
+
 void setModifiedBufferLength(uint32 length) {
 	_ModifiedBufferLength = length;
 }
@@ -348,6 +370,13 @@ void fault_handler(struct Trapframe *tf) {
 	// Read processor's CR2 register to find the faulting address
 	fault_va = rcr2();
 
+	//kernel faults in the kernel heap: the pages of the blocks reserved by kmalloc_reserve()
+	if (tf != NULL && (tf->tf_cs & 3) != 3 && fault_va >= KERNEL_HEAP_START && fault_va < KERNEL_HEAP_MAX) {
+		if (!kheap_fault_handler(fault_va))
+			panic("kernel page fault at va %x, it is not a reserved kernel heap page", fault_va);
+		return;
+	}
+
 	//get a pointer to the environment that caused the fault at runtime
 	struct Env* faulted_env = curenv;
 
@@ -364,6 +393,14 @@ void fault_handler(struct Trapframe *tf) {
 		// we have normal page fault =============================================================
 		faulted_env->pageFaultsCounter++;
 
+		//a write to a page that shares the zero frame gets its private frame in its place
+		faultIsWrite = tf == NULL || (tf->tf_err & FEC_WR);
+		if (faultIsWrite && (tf == NULL || (tf->tf_err & FEC_PR))
+				&& zeroPageCopyOnWrite(faulted_env, fault_va)) {
+			tlbflush();
+			return;
+		}
+
 		//		cprintf("[%08s] user PAGE fault va %08x\n", curenv->prog_name, fault_va);
 		//
 		//		cprintf("\nPage working set BEFORE fault handler...\n");
@@ -400,7 +437,33 @@ void table_fault_handler(struct Env * e, uint32 fault_va) {
 }
 
 void __page_fault_handler_with_buffering(struct Env * e, uint32 fault_va) {
+	//a buffered page is still in its frame, it's reclaimed without reading it from the page file
+	//and only needs a working set entry (the victim of a full working set is buffered too)
+	uint32 pagePermission = pt_get_page_permissions(e, fault_va);
+	if ((pagePermission & PERM_BUFFERED) && !(pagePermission & PERM_PRESENT)) {
+		struct MemAdvice* advice = env_advice_lookup(e, fault_va);
+		if (advice != NULL && advice->advice == MADV_SEQUENTIAL)
+			advice->last_fault = ROUNDDOWN(fault_va, PAGE_SIZE);
+
+		if (env_page_ws_get_size(e) == e->page_WS_max_size)
+			removePage(e, findVictimPage(e));
+
+		//its frame is taken by the kernel only when there is no other free frame, then it is placed again
+		if (reclaim_buffered_page(e, fault_va)) {
+			env_page_ws_set_entry(e, e->page_last_WS_index++, ROUNDDOWN(fault_va, PAGE_SIZE));
+			if (e->page_last_WS_index == e->page_WS_max_size)
+				e->page_last_WS_index = 0;
+		}
+		else
+			placement(e, fault_va);
 
+		if (advice != NULL && advice->advice == MADV_SEQUENTIAL)
+			readAhead(e, advice, fault_va);
+		return;
+	}
+
+	//otherwise the page is placed as without buffering, removePage() buffers the victims
+	page_fault_handler(e, fault_va);
 }
 
 //Handle the page fault
@@ -410,6 +473,11 @@ void page_fault_handler(struct Env * curenv, uint32 fault_va) {
 	//panic("page_fault_handler() is not implemented yet...!!");
 
 	//refer to the project documentation for the detailed steps
+	//a SEQUENTIAL range remembers its last fault, its pages behind it are the first victims
+	struct MemAdvice* advice = env_advice_lookup(curenv, fault_va);
+	if (advice != NULL && advice->advice == MADV_SEQUENTIAL)
+		advice->last_fault = ROUNDDOWN(fault_va, PAGE_SIZE);
+
 	//check placement first
 	if (env_page_ws_get_size(curenv) < curenv->page_WS_max_size) {
 		//placement
@@ -429,6 +497,10 @@ void page_fault_handler(struct Env * curenv, uint32 fault_va) {
 	}
 
 	//TODO: [PROJECT 2016 - BONUS3] Apply FIFO and modifiedCLOCK algorithms
+
+	//then load the next pages of a SEQUENTIAL range
+	if (advice != NULL && advice->advice == MADV_SEQUENTIAL)
+		readAhead(curenv, advice, fault_va);
 }
 
 //my helper functions
@@ -466,30 +538,76 @@ int findVictimPageCLOCK(struct Env* e) {
 	}
 }
 
+//returns the ws index of a page of a SEQUENTIAL range that is behind the last fault of the range
+//(it's not accessed again soon), or -1 if there is no such page
+int findVictimPageBehind(struct Env* e) {
+	int i;
+	for (i = 0; i < e->page_WS_max_size; i++) {
+		if (e->ptr_pageWorkingSet[i].empty)
+			continue;
+		uint32 va = e->ptr_pageWorkingSet[i].virtual_address;
+		struct MemAdvice* advice = env_advice_lookup(e, va);
+		if (advice != NULL && advice->advice == MADV_SEQUENTIAL && va < advice->last_fault)
+			return i;
+	}
+	return -1;
+}
+
+//load the pages after the faulted page of the SEQUENTIAL range, the pages behind the faults
+//give their entries to them when the working set is full
+void readAhead(struct Env* e, struct MemAdvice* advice, uint32 faultedVA) {
+	uint32 start = ROUNDDOWN(faultedVA, PAGE_SIZE) + PAGE_SIZE;
+	uint32 pages = READ_AHEAD_PAGES;
+	if (start >= advice->end)
+		return;
+	if ((advice->end - start) / PAGE_SIZE < pages)
+		pages = (advice->end - start) / PAGE_SIZE;
+
+	int victimPageIndex;
+	while (e->page_WS_max_size - env_page_ws_get_size(e) < pages
+			&& (victimPageIndex = findVictimPageBehind(e)) >= 0)
+		removePage(e, victimPageIndex);
+
+	prefaultMem(e, start, pages * PAGE_SIZE);
+}
+
 void placement(struct Env * e, uint32 fault_va) {
 
-	//allocate frame for the faulted page
+	//check if the faulted page exist in the page file, otherwise it must be a new stack page
+	//or the first access to a page of a zero-fill region
+	int inPageFile = pf_env_page_exists(e, fault_va);
+	int inAnonRegion = !inPageFile && env_anon_region_lookup(e, fault_va) != NULL;
+	if (!inPageFile && !inAnonRegion && !(fault_va >= USTACKBOTTOM && fault_va < USTACKTOP)) {
+		panic("ERROR: Not stack page!");
+		return;
+	}
+
+	//allocate frame for the faulted page (a new stack or region page is initialized by 0's),
+	//a read from a region page shares the zero frame read only until its first write
 	struct Frame_Info* frameInfo = NULL;
-	allocate_frame(&frameInfo);
+	int perm = PERM_PRESENT | PERM_USER | PERM_WRITEABLE;
+	if (inAnonRegion && !faultIsWrite && isZeroPageSharingEnabled()) {
+		frameInfo = to_frame_info(STATIC_KERNEL_PHYSICAL_ADDRESS(ptr_zero_page));
+		perm = PERM_PRESENT | PERM_USER;
+	}
+	else if (inPageFile)
+		allocate_frame(&frameInfo);
+	else
+		allocate_zeroed_frame(&frameInfo);
 
 	//map the allocated frame to the given virtual address
-	map_frame(e->env_page_directory, frameInfo, (void*) fault_va,
-			PERM_PRESENT | PERM_USER | PERM_WRITEABLE);
-
-	//check if the faulted page exist in the page file
-	if (pf_read_env_page(e, (void*) fault_va) && (fault_va >= USTACKBOTTOM
-			&& fault_va < USTACKTOP)) {
-
+	map_frame(e->env_page_directory, frameInfo, (void*) fault_va, perm);
+
+	if (inPageFile) {
+		//load the page from the page file
+		pf_read_env_page(e, (void*) fault_va);
+	} else if (inAnonRegion) {
+		//the region page takes its page file slot at its first eviction
+	} else if (pf_add_empty_env_page(e, fault_va, 0)) {
 		//the page does not exist and it's a stack page
 		//then add empty stack page to the page file
-		if (pf_add_empty_env_page(e, fault_va, 0)) {
-			//no space in the page file
-			panic("ERROR: No enough virtual space on the page file");
-			return;
-		}
-	} else if (pf_read_env_page(e, (void*) fault_va) && !(fault_va
-			>= USTACKBOTTOM && fault_va < USTACKTOP)) {
-		panic("ERROR: Not stack page!");
+		//no space in the page file
+		panic("ERROR: No enough virtual space on the page file");
 		return;
 	}
 
@@ -508,17 +626,24 @@ void placement(struct Env * e, uint32 fault_va) {
 
 }
 
+//returns the ws index of the page that will be replaced (a page behind a sequential access first,
+//then by the replacement algorithm), the last ws index is left at it for the placement
+int findVictimPage(struct Env* e) {
+	int victimPageIndex = findVictimPageBehind(e);
+	if (victimPageIndex < 0)
+		victimPageIndex = isPageReplacmentAlgorithmCLOCK() ? findVictimPageCLOCK(e) : findVictimPageLRU(e);
+	e->page_last_WS_index = victimPageIndex;
+	return victimPageIndex;
+}
+
 void LRUreplacement(struct Env* e, uint32 faultedVA) {
 	//first find the page that will be replaced
-	int victimPageIndex = findVictimPageLRU(e);
+	int victimPageIndex = findVictimPage(e);
 
 	//remove the victim page from the ws and from the memory
 	//and if it is a modified page it will be updated on the page file
 	removePage(e, victimPageIndex);
 
-	//prepare the last ws index for the placement
-	e->page_last_WS_index = victimPageIndex;
-
 	//then we can make normal replacement
 	placement(e, faultedVA);
 
@@ -526,7 +651,7 @@ void LRUreplacement(struct Env* e, uint32 faultedVA) {
 
 void CLOCKreplacement(struct Env* e, uint32 faultedVA) {
 	//first find the page that will be replaced
-	int victimPageIndex = findVictimPageCLOCK(e);
+	int victimPageIndex = findVictimPage(e);
 
 	//remove the victim page from the ws and from the memory
 	//and if it is a modified page it will be updated on the page file
@@ -537,6 +662,33 @@ void CLOCKreplacement(struct Env* e, uint32 faultedVA) {
 
 }
 
+//give a private zeroed frame to the page that shares the zero frame at the given address,
+//returns 0 if the page does not share the zero frame
+int zeroPageCopyOnWrite(struct Env* e, uint32 faultedVA) {
+	uint32* pageTableVA = NULL;
+	struct Frame_Info* frameInfo = get_frame_info(e->env_page_directory, (void*) faultedVA, &pageTableVA);
+	if (frameInfo == NULL || frameInfo != to_frame_info(STATIC_KERNEL_PHYSICAL_ADDRESS(ptr_zero_page)))
+		return 0;
+
+	//the private frame takes the place of the zero frame (map_frame() unmaps it)
+	struct Frame_Info* privateFrameInfo = NULL;
+	if (allocate_zeroed_frame(&privateFrameInfo) != 0)
+		panic("ERROR: No enough memory for the copy on write of the zero page");
+	map_frame(e->env_page_directory, privateFrameInfo, (void*) faultedVA,
+			PERM_PRESENT | PERM_USER | PERM_WRITEABLE);
+
+	//the page keeps its working set entry, its new frame keeps the index of the entry
+	int i;
+	for (i = 0; i < e->page_WS_max_size; i++)
+		if (!e->ptr_pageWorkingSet[i].empty
+				&& e->ptr_pageWorkingSet[i].virtual_address == ROUNDDOWN(faultedVA, PAGE_SIZE)) {
+			privateFrameInfo->ws_index = i;
+			break;
+		}
+
+	return 1;
+}
+
 void removePage(struct Env* e, int victimPageIndex) {
 	//get the victim page virtual address
 	uint32 victimPageVA =
@@ -547,31 +699,39 @@ void removePage(struct Env* e, int victimPageIndex) {
 	get_page_table(e->env_page_directory, (void*) victimPageVA, &pageTableVA);
 	if(pageTableVA == NULL) return;
 
+	//while buffering, a private page stays in its frame (not the shared zero frame)
+	struct Frame_Info* frameInfo = get_frame_info(e->env_page_directory,
+			(void*) victimPageVA, &pageTableVA);
+	int buffered = isBufferingEnabled() && frameInfo != NULL && frameInfo->references == 1;
+
 	//check the victimPage modification
 	if (pageTableVA[PTX(victimPageVA)] & PERM_MODIFIED) {
 		//this page is already modified, then update it in the page file
-
-		//first get the victim page frame info
-		struct Frame_Info* frameInfo = NULL;
-		frameInfo = get_frame_info(e->env_page_directory,
-				(void*) victimPageVA, &pageTableVA);
+		//(a buffered page is written later, it only needs its slot now)
 		if (frameInfo == NULL) return;
 
 		//then update the victim frame in the page file
-		if (pf_update_env_page(e, (void*) victimPageVA, frameInfo)) {
+		if (buffered ? !pf_env_page_exists(e, victimPageVA)
+				: pf_update_env_page(e, (void*) victimPageVA, frameInfo)) {
 			//the page is not exist in the page file, then add and update it
-			//first add
+			//first add (a page of a zero-fill region takes its reserved slot)
+			if (env_anon_region_lookup(e, victimPageVA) != NULL)
+				env_anon_unreserve_pages(e, 1);
 			if (pf_add_empty_env_page(e, victimPageVA, 0))
 				panic("ERROR: No enough virtual space on the page file");
 
 			//then update
-			pf_update_env_page(e, (void*) victimPageVA, frameInfo);
+			if (!buffered)
+				pf_update_env_page(e, (void*) victimPageVA, frameInfo);
 		}
 
 	}
 
-	//unmap the victim page after checking the modification
-	unmap_frame(e->env_page_directory, (void*) victimPageVA);
+	//unmap (or buffer) the victim page after checking the modification
+	if (buffered)
+		buffer_env_page(e, victimPageVA);
+	else
+		unmap_frame(e->env_page_directory, (void*) victimPageVA);
 
 	//update the working set
 	env_page_ws_clear_entry(e, victimPageIndex);
@@ -16,6 +16,7 @@ extern uint8 bypassInstrLength ;
 
 uint32 _EnableModifiedBuffer ;
 uint32 _EnableBuffering ;
+uint32 _EnableZeroPageSharing ;
 
 
 uint32 _PageRepAlgoType;
@@ -43,4 +44,7 @@ uint32 isPageReplacmentAlgorithmModifiedCLOCK();
 void enableModifiedBuffer(uint32 enableIt);
 uint32 isModifiedBufferEnabled();
 
+void enableZeroPageSharing(uint32 enableIt);
+uint32 isZeroPageSharingEnabled();
+
 #endif /* FOS_KERN_TRAP_H */
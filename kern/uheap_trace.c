@@ -0,0 +1,161 @@
+/*
+ * Tracing of the user heap calls.
+ *
+ * When the tracing is on, lib/uheap.c gives each malloc/free/realloc call of
+ * a program to sys_uheap_trace(), which keeps it in the ring of the env. The
+ * rings are shown by the uheapstats command: size histogram, search steps of
+ * each placement strategy, calls of each caller and fragmentation over time.
+ */
+
+#include <inc/mmu.h>
+#include <inc/stdio.h>
+#include <inc/assert.h>
+#include <inc/string.h>
+
+#include <kern/uheap_trace.h>
+#include <kern/kheap.h>
+
+//the ring of each env slot (ENVX of the env id)
+struct uheapTrace* uheapTraces[NENV];
+
+void enableUHeapTracing(uint32 enableIt)
+{
+	//a new tracing starts with empty rings
+	if (enableIt && !_EnableUHeapTracing)
+	{
+		int i;
+		for (i = 0; i < NENV; i++)
+		{
+			if (uheapTraces[i] != NULL)
+				kfree(uheapTraces[i]);
+			uheapTraces[i] = NULL;
+		}
+	}
+	_EnableUHeapTracing = enableIt;
+}
+
+uint32 isUHeapTracingEnabled()
+{
+	return _EnableUHeapTracing;
+}
+
+//record the event in the ring of the env, returns 0 if the tracing is off or there is no memory for the ring
+int uheap_trace_record(struct Env* e, struct uheapTraceEvent* event)
+{
+	if (!_EnableUHeapTracing)
+		return 0;
+
+	struct uheapTrace* trace = uheapTraces[ENVX(e->env_id)];
+	if (trace == NULL)
+	{
+		//the ring is filled from its start, most programs touch only its first pages, so its
+		//pages are reserved and each one takes a frame at its first event
+		trace = kmalloc_reserve(sizeof(struct uheapTrace));
+		if (trace == NULL)
+			return 0;
+		uheapTraces[ENVX(e->env_id)] = trace;
+		trace->env_id = 0;
+	}
+	//the slot is taken by a new env
+	if (trace->env_id != e->env_id)
+	{
+		trace->env_id = e->env_id;
+		trace->prog_name = e->prog_name;
+		trace->eventsNumber = 0;
+	}
+
+	trace->events[trace->eventsNumber % UHEAP_TRACE_SIZE] = *event;
+	trace->eventsNumber++;
+	return 1;
+}
+
+void uheap_trace_list()
+{
+	cprintf("env id\t\tprogram\t\tevents\n");
+	int i;
+	for (i = 0; i < NENV; i++)
+		if (uheapTraces[i] != NULL && uheapTraces[i]->eventsNumber > 0)
+			cprintf("%d\t\t%s\t\t%d\n", uheapTraces[i]->env_id, uheapTraces[i]->prog_name, uheapTraces[i]->eventsNumber);
+}
+
+//print the statistics of the ring of the given env, returns 0 if the env has no ring
+int uheap_trace_print(int32 envId)
+{
+	struct uheapTrace* trace = uheapTraces[ENVX(envId)];
+	if (trace == NULL || trace->env_id != envId || trace->eventsNumber == 0)
+		return 0;
+
+	//the events of the ring from the oldest one
+	uint32 first = trace->eventsNumber > UHEAP_TRACE_SIZE ? trace->eventsNumber - UHEAP_TRACE_SIZE : 0;
+	uint32 count = trace->eventsNumber - first;
+	cprintf("[%s] %d heap calls, the last %d are kept\n", trace->prog_name, trace->eventsNumber, count);
+
+	uint32 histogram[32], strategyCalls[5], strategySteps[5];
+	uint32 callers[UHEAP_TRACE_CALLERS], callerCalls[UHEAP_TRACE_CALLERS], callerKB[UHEAP_TRACE_CALLERS];
+	uint32 numOfCallers = 0, i, j;
+	memset(histogram, 0, sizeof(histogram));
+	memset(strategyCalls, 0, sizeof(strategyCalls));
+	memset(strategySteps, 0, sizeof(strategySteps));
+
+	for (i = first; i < trace->eventsNumber; i++)
+	{
+		struct uheapTraceEvent* event = &trace->events[i % UHEAP_TRACE_SIZE];
+		if (event->type == UHT_FREE)
+			continue;
+
+		//the allocations by size (bucket k holds sizes up to 2^k bytes)
+		uint32 bucket = 0;
+		while (bucket < 31 && (1U << bucket) < event->size)
+			bucket++;
+		histogram[bucket]++;
+
+		if (event->strategy <= UHP_PLACE_WORSTFIT)
+		{
+			strategyCalls[event->strategy]++;
+			strategySteps[event->strategy] += event->searchSteps;
+		}
+
+		for (j = 0; j < numOfCallers && callers[j] != event->caller; j++) ;
+		if (j == numOfCallers && numOfCallers < UHEAP_TRACE_CALLERS)
+		{
+			callers[j] = event->caller;
+			callerCalls[j] = callerKB[j] = 0;
+			numOfCallers++;
+		}
+		if (j < numOfCallers)
+		{
+			callerCalls[j]++;
+			callerKB[j] += ROUNDUP(event->size, 1024) / 1024;
+		}
+	}
+
+	cprintf("size (bytes)\t\tallocations\n");
+	for (i = 0; i < 32; i++)
+		if (histogram[i] > 0)
+			cprintf("<= %u\t\t%d\n", 1U << i, histogram[i]);
+
+	static const char* strategyNames[5] = { "", "FIRST FIT", "BEST FIT", "NEXT FIT", "WORST FIT" };
+	cprintf("strategy\t\tallocations\tsearch steps (avg)\n");
+	for (i = 1; i <= UHP_PLACE_WORSTFIT; i++)
+		if (strategyCalls[i] > 0)
+			cprintf("%s\t\t%d\t\t%d.%02d\n", strategyNames[i], strategyCalls[i], strategySteps[i] / strategyCalls[i],
+					strategySteps[i] * 100 / strategyCalls[i] % 100);
+
+	cprintf("caller eip\t\tallocations\tKB\n");
+	for (j = 0; j < numOfCallers; j++)
+		cprintf("%08x\t\t%d\t\t%d\n", callers[j], callerCalls[j], callerKB[j]);
+
+	//fragmentation: the part of the free pages that is not in the largest free block
+	cprintf("event\t\tfree KB\t\tlargest KB\tfragmentation\n");
+	uint32 samples = count < UHEAP_TRACE_SAMPLES ? count : UHEAP_TRACE_SAMPLES;
+	for (i = 0; i < samples; i++)
+	{
+		//spread evenly from the oldest event to the newest one
+		uint32 index = first + (samples == 1 ? 0 : (count - 1) * i / (samples - 1));
+		struct uheapTraceEvent* event = &trace->events[index % UHEAP_TRACE_SIZE];
+		uint32 fragmentation = event->freePages > 0 ? 100 - event->largestFreePages * 100 / event->freePages : 0;
+		cprintf("%d\t\t%d\t\t%d\t\t%d%%\n", index, event->freePages * (PAGE_SIZE/1024),
+				event->largestFreePages * (PAGE_SIZE/1024), fragmentation);
+	}
+	return 1;
+}
@@ -0,0 +1,37 @@
+#ifndef FOS_KERN_UHEAP_TRACE_H_
+#define FOS_KERN_UHEAP_TRACE_H_
+
+#ifndef FOS_KERNEL
+# error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/environment_definitions.h>
+#include <inc/uheap.h>
+
+//events kept by the ring of one env (the last ones)
+#define UHEAP_TRACE_SIZE	512
+//callers shown by uheapstats
+#define UHEAP_TRACE_CALLERS	16
+//fragmentation samples shown by uheapstats
+#define UHEAP_TRACE_SAMPLES	8
+
+//The user heap calls of one env (recorded by lib/uheap.c through sys_uheap_trace).
+//The ring stays after the env exits, until its slot is taken by a new env.
+struct uheapTrace
+{
+	int32 env_id;
+	const char* prog_name;
+	uint32 eventsNumber;	//all recorded events, the ring keeps the last UHEAP_TRACE_SIZE
+	struct uheapTraceEvent events[UHEAP_TRACE_SIZE];
+};
+
+uint32 _EnableUHeapTracing;
+
+void enableUHeapTracing(uint32 enableIt);
+uint32 isUHeapTracingEnabled();
+int uheap_trace_record(struct Env* e, struct uheapTraceEvent* event);
+void uheap_trace_list();
+int uheap_trace_print(int32 envId);
+
+#endif /* FOS_KERN_UHEAP_TRACE_H_ */
@@ -15,6 +15,7 @@
 #include <kern/helpers.h>
 #include <kern/sched.h>
 #include <kern/kheap.h>
+#include <kern/kmem_cache.h>
 #include <inc/queue.h>
 
 //my helper functions
@@ -99,7 +100,13 @@ DECLARE_START_OF(tst_free_2);
 DECLARE_START_OF(tst_malloc_1);
 DECLARE_START_OF(tst_malloc_2);
 DECLARE_START_OF(tst_malloc_3);
+DECLARE_START_OF(tst_malloc_small);
+DECLARE_START_OF(tst_malloc_lazy);
+DECLARE_START_OF(tst_calloc);
+DECLARE_START_OF(tst_malloc_populate);
+DECLARE_START_OF(tst_madvise);
 DECLARE_START_OF(tst_nextfit);
+DECLARE_START_OF(tst_heap_index);
 DECLARE_START_OF(tst_best_fit_1);
 DECLARE_START_OF(tst_best_fit_2);
 DECLARE_START_OF(tst_first_fit_1);
@@ -112,6 +119,11 @@ DECLARE_START_OF(mergesort_noleakage);
 DECLARE_START_OF(quicksort_noleakage);
 DECLARE_START_OF(tst_realloc_1);
 DECLARE_START_OF(tst_realloc_2);
+DECLARE_START_OF(tst_realloc_time);
+DECLARE_START_OF(tst_free_time);
+DECLARE_START_OF(tst_uheap_trace);
+DECLARE_START_OF(tst_heap_trim);
+DECLARE_START_OF(tst_page_buffering);
 DECLARE_START_OF(tst_freeRAM_1);
 DECLARE_START_OF(tst_freeRAM_2);
 DECLARE_START_OF(tst_page_replacement_FIFO_1);
@@ -141,6 +153,11 @@ struct UserProgramInfo userPrograms[] = {
 		{ "tm1", "tests malloc (1): start address & allocated frames", PTR_START_OF(tst_malloc_1)},
 		{ "tm2", "tests malloc (2): writing & reading values in allocated spaces", PTR_START_OF(tst_malloc_2)},
 		{ "tm3", "tests malloc (3): check memory allocation and WS after accessing", PTR_START_OF(tst_malloc_3)},
+		{ "tms", "tests malloc of small objects: size classes sharing pages", PTR_START_OF(tst_malloc_small)},
+		{ "tml", "tests zero-fill-on-demand malloc: lazy pages, eviction and malloc time", PTR_START_OF(tst_malloc_lazy)},
+		{ "tcalloc", "tests calloc: zeroed objects, shared zero frame and copy on write (command: zeropage)", PTR_START_OF(tst_calloc)},
+		{ "tmpop", "tests malloc_populate: pages loaded with the allocation and first touch time", PTR_START_OF(tst_malloc_populate)},
+		{ "tmadv", "tests sys_madvise: WILLNEED, DONTNEED, SEQUENTIAL and the hints limit", PTR_START_OF(tst_madvise)},
 
 		{ "tf1", "tests free (1): freeing tables, WS and page file [placement case]", PTR_START_OF(tst_free_1)},
 		{ "tf2", "tests free (2): try accessing values in freed spaces", PTR_START_OF(tst_free_2)},
@@ -148,6 +165,7 @@ struct UserProgramInfo userPrograms[] = {
 		{ "tnf", "tests next fit: all cases", PTR_START_OF(tst_nextfit)},
 		{ "tbf1", "tests best fit (1): always find suitable space", PTR_START_OF(tst_best_fit_1)},
 		{ "tbf2", "tests best fit (2): no suitable space", PTR_START_OF(tst_best_fit_2)},
+		{ "thi", "tests the indexed heap searches against the linear scans", PTR_START_OF(tst_heap_index)},
 
 		{ "hp", "heap program (allocate and free from heap)", PTR_START_OF(heap_program)},
 
@@ -171,6 +189,11 @@ struct UserProgramInfo userPrograms[] = {
 		{ "twf", "tests worst fit: all cases", PTR_START_OF(tst_worstfit)},
 		{ "tr1", "tests realloc (1): normal cases", PTR_START_OF(tst_realloc_1)},
 		{ "tr2", "tests realloc (2): special cases", PTR_START_OF(tst_realloc_2)},
+		{ "trtime", "measures realloc cost versus size", PTR_START_OF(tst_realloc_time)},
+		{ "tftime", "measures free cost versus size", PTR_START_OF(tst_free_time)},
+		{ "tuhtrace", "a mix of heap calls to trace (commands: uheaptrace, uheapstats)", PTR_START_OF(tst_uheap_trace)},
+		{ "thtrim", "tests the heap trimming: tables of the free 4 MB spans released after bursts", PTR_START_OF(tst_heap_trim)},
+		{ "tpbuff", "tests the page buffering: evicted pages reclaimed without reading the page file", PTR_START_OF(tst_page_buffering)},
 		{ "tfr1", "tests freeRAM (1): run in specific scenario", PTR_START_OF(tst_freeRAM_1)},
 		{ "tfr2", "tests freeRAM (2): run directly", PTR_START_OF(tst_freeRAM_2)},
 		{ "tfifo1", "Tests page replacement (FIFO algorithm 1)", PTR_START_OF(tst_page_replacement_FIFO_1)},
@@ -220,8 +243,12 @@ void * create_user_page_WS(unsigned int numOfElements)
 	//Use kmalloc() to allocate a new space for a working set with numOfElements elements
 	//refer to the project documentation for the detailed steps
 
+	//the frames of the working set are mapped into the user space, so it takes
+	//whole pages of its own (a small one is not carved from a shared slab)
+	uint32 size = ROUNDUP(numOfElements * sizeof(struct WorkingSetElement), PAGE_SIZE);
+
 	//change this "return" according to your answer
-	return kmalloc(numOfElements * sizeof(struct WorkingSetElement));
+	return kmalloc(size);
 }
 
 
@@ -236,7 +263,7 @@ void * create_user_directory()
 	//cprintf("hello from the other function :v");
 
 	//allocate a new page for the user directory
-	uint32* userDirectory = kmalloc(PAGE_SIZE);
+	uint32* userDirectory = kmem_cache_alloc(page_directory_cache);
 
 	//copy the kernel directory into the user directory
 //	int i;
@@ -282,14 +309,9 @@ void initialize_environment(struct Env* e, uint32* ptr_user_page_directory
 
 		e->ptr_pageWorkingSet = create_user_page_WS(e->page_WS_max_size);
 
-		unsigned int sva = (unsigned int)e->ptr_pageWorkingSet;
+		//share the frames of the working set with the user (read only)
 		uint32 nBytes = sizeof(struct WorkingSetElement) * e->page_WS_max_size;
-		unsigned int dva = (unsigned int) (e->__uptr_pws);
-		for(sva = (uint32)(e->ptr_pageWorkingSet); sva < ((uint32)(e->ptr_pageWorkingSet) + nBytes) ; sva+=PAGE_SIZE, dva+=PAGE_SIZE)
-		{
-			unsigned int pa = kheap_physical_address(sva);
-			map_frame(e->env_page_directory, to_frame_info(pa), (void*)dva, PERM_USER);
-		}
+		map_frame_range(e->env_page_directory, (uint32)e->__uptr_pws, nBytes, (uint32)e->ptr_pageWorkingSet, PERM_USER);
 	}
 #else
 	{
@@ -319,12 +341,18 @@ void initialize_environment(struct Env* e, uint32* ptr_user_page_directory
 
 	e->pageFaultsCounter=0;
 	e->tableFaultsCounter=0;
+	e->pageFileReadsCounter=0;
+	e->pageFileTransfersCounter=0;
 
 	e->nModifiedPages=0;
 	e->nNotModifiedPages=0;
 
 	e->shared_free_address = USER_SHARED_MEM_START;
 
+	LIST_INIT(&e->anon_regions);
+	e->anon_reserved_pages = 0;
+	e->mem_advices = NULL;
+
 	//Completes other environment initializations, (envID, status and most of registers)
 	complete_environment_initialization(e);
 }
@@ -347,7 +375,6 @@ static int program_segment_alloc_map_copy_workingset(struct Env *e, struct Progr
 	uint32 iVA = ROUNDDOWN((uint32)vaddr,PAGE_SIZE) ;
 	int r ;
 	uint32 i = 0 ;
-	struct Frame_Info *p = NULL;
 
 	*allocated_pages = 0;
 
@@ -355,15 +382,20 @@ static int program_segment_alloc_map_copy_workingset(struct Env *e, struct Progr
 	if (iVA == 0x200000 && strcmp(e->prog_name, "tpp")!=0)
 		remaining_ws_pages = remaining_ws_pages < 6 ? remaining_ws_pages:6 ;
 	/*==========================================================================================*/
+	// Allocate and map the pages at once, the pages past the file data (bss) get zeroed frames
+	uint32 numOfPages = (end_vaddr - iVA) / PAGE_SIZE;
+	if (numOfPages > remaining_ws_pages)
+		numOfPages = remaining_ws_pages;
+	uint32 end_file_vaddr = ROUNDUP((uint32)vaddr + seg->size_in_file, PAGE_SIZE);
+	uint32 numOfFilePages = (end_file_vaddr - iVA) / PAGE_SIZE;
+	if (numOfFilePages > numOfPages)
+		numOfFilePages = numOfPages;
+	map_frame_range(e->env_page_directory, iVA, numOfFilePages * PAGE_SIZE, 0, PERM_USER | PERM_WRITEABLE);
+	map_zeroed_frame_range(e->env_page_directory, iVA + numOfFilePages * PAGE_SIZE, (numOfPages - numOfFilePages) * PAGE_SIZE, PERM_USER | PERM_WRITEABLE);
+	LOG_STRING("segment pages allocated and mapped");
+
 	for (; iVA < end_vaddr && i<remaining_ws_pages; i++, iVA += PAGE_SIZE)
 	{
-		// Allocate a page
-		allocate_frame(&p) ;
-
-		LOG_STRING("segment page allocated");
-		loadtime_map_frame(e->env_page_directory, p, (void *)iVA, PERM_USER | PERM_WRITEABLE);
-		LOG_STRING("segment page mapped");
-
 		LOG_STATMENT(cprintf("Updating working set entry # %d",e->page_last_WS_index));
 
 		e->ptr_pageWorkingSet[e->page_last_WS_index].virtual_address = iVA;
@@ -401,7 +433,9 @@ static int program_segment_alloc_map_copy_workingset(struct Env *e, struct Progr
 		src_ptr++ ;
 	}
 	LOG_STRING("zeroing remaining page space");
-	while((uint32)dst_ptr < (ROUNDDOWN((uint32)vaddr,PAGE_SIZE) + (*allocated_pages)*PAGE_SIZE) )
+	//(only the last file page, the pages after it are already zeroed)
+	while((uint32)dst_ptr < (ROUNDDOWN((uint32)vaddr,PAGE_SIZE) + (*allocated_pages)*PAGE_SIZE) &&
+			(uint32)dst_ptr < end_file_vaddr)
 	{
 		*dst_ptr = 0;
 		dst_ptr++ ;
@@ -621,14 +655,12 @@ struct Env* env_create(char* user_program_name, unsigned int page_WS_size)
 	uint32 stackVa = USTACKTOP - PAGE_SIZE;
 	for(;stackVa >= ptr_user_stack_bottom; stackVa -= PAGE_SIZE)
 	{
+		//the new page is initialized by 0's
 		struct Frame_Info *pp = NULL;
-		allocate_frame(&pp);
+		allocate_zeroed_frame(&pp);
 
 		loadtime_map_frame(e->env_page_directory, pp, (void*)stackVa, PERM_USER | PERM_WRITEABLE);
 
-		//initialize new page by 0's
-		memset((void*)stackVa, 0, PAGE_SIZE);
-
 		//now add it to the working set and the page table
 		{
 			env_page_ws_set_entry(e, e->page_last_WS_index, (uint32) stackVa) ;
@@ -684,12 +716,7 @@ void __remove_pws_user_pages(struct Env *e)
 	if(USE_KHEAP)
 	{
 		uint32 nBytes = sizeof(struct WorkingSetElement) * e->page_WS_max_size;
-		unsigned int sva = (unsigned int) e->__uptr_pws;
-		for(; sva < ((unsigned int) (e->__uptr_pws) + nBytes) ; sva+=PAGE_SIZE)
-		{
-			//unsigned int pa = kheap_physical_address(sva);
-			unmap_frame(e->env_page_directory, (void*)sva);
-		}
+		unmap_range(e->env_page_directory, (uint32) e->__uptr_pws, nBytes);
 		//cprintf("after free pages\n");
 		unsigned int tsva = (unsigned int) e->__uptr_pws;
 		for(; tsva < ((unsigned int) (e->__uptr_pws) + nBytes) ; tsva+=PTSIZE)
@@ -707,6 +734,7 @@ void __remove_pws_user_pages(struct Env *e)
 //
 extern uint32 isBufferingEnabled();
 void __env_free_with_buffering(struct Env *e);
+void cleanup_buffers(struct Env* e);
 void env_free(struct Env *e);
 
 void start_env_free(struct Env *e)
@@ -748,10 +776,8 @@ void env_free(struct Env *e)
 	// [3] Free all TABLES from the main memory
 	// [4] Free the page DIRECTORY from the main memory
 
-	//free the ws pages in the main memory
-	int entryIndex;
-	for(entryIndex = 0; entryIndex < e->page_WS_max_size; entryIndex++)
-		unmap_frame(e->env_page_directory, (void*) e->ptr_pageWorkingSet[entryIndex].virtual_address);
+	//free the ws pages in the main memory, table by table
+	unmap_range(e->env_page_directory, 0, USER_TOP);
 	//free the working set space from the kernel heap
 	kfree(e->ptr_pageWorkingSet);
 
@@ -823,6 +849,15 @@ void env_free(struct Env *e)
 
 	//YOUR CODE ENDS HERE --------------------------------------------
 
+	//release the zero-fill regions and their reserved page file slots
+	env_anon_regions_free(e);
+	//release the access hints table (if any)
+	if(e->mem_advices != NULL)
+	{
+		kfree(e->mem_advices);
+		e->mem_advices = NULL;
+	}
+
 	//Don't change these lines:
 	pf_free_env(e); /*(ALREADY DONE for you)*/ // (removes all of the program pages from the page file)
 	free_environment(e); /*(ALREADY DONE for you)*/ // (frees the environment (returns it back to the free environment list))
@@ -830,7 +865,10 @@ void env_free(struct Env *e)
 
 void __env_free_with_buffering(struct Env *e)
 {
-
+	//the buffered pages of the env are not in its working set, their frames are freed first
+	//(they're already freed if the env has exited), then the env is freed as without buffering
+	cleanup_buffers(e);
+	env_free(e);
 }
 
 ///*****************************************************************************************
@@ -1030,8 +1068,11 @@ void cleanup_buffers(struct Env* e)
 	//	struct freeFramesCounters ffc = calculate_available_frames();
 	//	cprintf("[%s] bef, mod = %d, fb = %d, fnb = %d\n",curenv->prog_name, ffc.modified, ffc.freeBuffered, ffc.freeNotBuffered);
 
-	LIST_FOREACH(ptr_fi, &modified_frame_list)
+	//(free_frame() clears the links of the frame, so the next frame is taken before)
+	struct Frame_Info *ptr_next = NULL;
+	for(ptr_fi = LIST_FIRST(&modified_frame_list); ptr_fi != NULL; ptr_fi = ptr_next)
 	{
+		ptr_next = LIST_NEXT(ptr_fi);
 		if(ptr_fi->environment == e)
 		{
 			pt_clear_page_table_entry(ptr_fi->environment,ptr_fi->va);
@@ -1047,6 +1088,18 @@ void cleanup_buffers(struct Env* e)
 		}
 	}
 
+	//then the clean buffered pages of the env, they are at the tail of the free list
+	for(ptr_fi = LIST_LAST(&free_frame_list); ptr_fi != NULL && ptr_fi->isBuffered; ptr_fi = ptr_next)
+	{
+		ptr_next = LIST_PREV(ptr_fi);
+		if(ptr_fi->environment == e)
+		{
+			pt_clear_page_table_entry(ptr_fi->environment,ptr_fi->va);
+			bufferlist_remove_page(&free_frame_list, ptr_fi);
+			free_frame(ptr_fi);
+		}
+	}
+
 	//	cprintf("[%s] finished deleting modified frames at the end of env\n", curenv->prog_name);
 	//	struct freeFramesCounters ffc2 = calculate_available_frames();
 	//	cprintf("[%s] aft, mod = %d, fb = %d, fnb = %d\n",curenv->prog_name, ffc2.modified, ffc2.freeBuffered, ffc2.freeNotBuffered);
@@ -108,6 +108,27 @@ void sys_allocateMem(uint32 virtual_address, uint32 size)
 	return ;
 }
 
+void sys_allocateMem_prefault(uint32 virtual_address, uint32 size)
+{
+	syscall(SYS_allocateMem, virtual_address, size, 1, 0, 0);
+	return ;
+}
+
+int sys_madvise(uint32 virtual_address, uint32 size, uint32 advice)
+{
+	return syscall(SYS_madvise, virtual_address, size, advice, 0, 0);
+}
+
+int sys_uheap_trace(struct uheapTraceEvent* event)
+{
+	return syscall(SYS_uheap_trace, (uint32) event, 0, 0, 0, 0);
+}
+
+int sys_trimMem(uint32 virtual_address, uint32 size)
+{
+	return syscall(SYS_trimMem, virtual_address, size, 0, 0, 0);
+}
+
 int sys_pf_calculate_allocated_pages()
 {
 	return syscall(SYS_pf_calc_allocated_pages, 0,0,0,0,0);
@@ -222,6 +243,13 @@ sys_get_virtual_time()
 	return result;
 }
 
+//the virtual time elapsed since the given time of sys_get_virtual_time() (its low 32 bits)
+uint32
+get_virtual_time_since(struct uint64 start)
+{
+	return sys_get_virtual_time().low - start.low;
+}
+
 // 2014
 void sys_moveMem(uint32 src_virtual_address, uint32 dst_virtual_address, uint32 size)
 {
@@ -11,24 +11,91 @@
  *	-there's no suitable space for the required allocation
  */
 
-//my helper structure
-struct memBlock{
-	//block pages, and we can get the next block
-	int blockPages;
-	int priorBlockIndex;
-};
-
 //my helper global variables
 uint32 NEXT_FIT_PTR = USER_HEAP_START;
 int NEXT_FIT_INDEX = 0;
+//the pages of the block allocated by the current malloc() are loaded by the kernel (see malloc_populate())
+int heapPopulate = 0;
+//tracing of the heap calls: -1 until the kernel is asked if it's on, the nested calls are not traced
+int heapTracing = -1, heapTraceDepth = 0;
+//blocks visited by the searches of the current call and free pages of the heap
+uint32 heapSearchSteps = 0, heapFreePages = 0;
+//pages freed since the last trim, the kernel tables of the 4 MB spans of the free tail of the
+//heap are released once they reach the threshold of 16 tables of pages (see heapTrim())
+uint32 heapUntrimmedPages = 0;
+#define HEAP_TRIM_THRESHOLD (16 * (PTSIZE / PAGE_SIZE))
 
 #define HEAP_PAGES_NUMBER (USER_HEAP_MAX - USER_HEAP_START) / PAGE_SIZE //max 2^18 which fit into int (2^31 - 1)
-struct memBlock heapBlocks[HEAP_PAGES_NUMBER] = {{HEAP_PAGES_NUMBER, 0}};
+
+//my helper structure
+//every block of the heap (free or allocated) has a node, so the metadata grows with the number of
+//blocks and not with the heap size. The nodes are in two treaps, one of all the blocks ordered by
+//the block start (with the largest free block of each subtree) and one of the free blocks ordered
+//by (pages, start), so all the placement strategies find their block in O(log n) with the same
+//decision as a linear scan
+#define ADDRESS_TREE 0
+#define SIZE_TREE 1
+
+struct heapBlock{
+	int start;
+	int pages;		//> 0 for a free block, < 0 for an allocated block
+	int maxPages;		//largest free block in the ADDRESS subtree
+	uint32 priority;
+	int left[2], right[2];	//children in each tree (node 0 is the empty tree)
+};
+
+//the nodes are kept in chunks, the first one is static and the others are taken from the heap itself
+#define HEAP_BLOCKS_PER_CHUNK 1024
+#define HEAP_BLOCKS_CHUNK_SIZE (HEAP_BLOCKS_PER_CHUNK * sizeof(struct heapBlock))
+//every block has at least one page
+#define MAX_HEAP_BLOCK_CHUNKS (HEAP_PAGES_NUMBER / HEAP_BLOCKS_PER_CHUNK + 1)
+#define BLOCK(n) (heapBlockChunks[(n) / HEAP_BLOCKS_PER_CHUNK][(n) % HEAP_BLOCKS_PER_CHUNK])
+
+struct heapBlock heapBlocksFirstChunk[HEAP_BLOCKS_PER_CHUNK];
+struct heapBlock* heapBlockChunks[MAX_HEAP_BLOCK_CHUNKS] = {heapBlocksFirstChunk};
+int heapBlockChunksNumber = 1;
+int heapBlocksRoot[2];
+int unusedHeapBlocks = 0;	//released nodes, linked through left[ADDRESS_TREE]
+int unusedHeapBlocksNumber = 0;
+int newHeapBlocks = 1;		//nodes after it are never used
+uint32 heapBlocksSeed = 1;
+int heapBlocksReady = 0;
+int heapBlocksRefilling = 0;
+
+//small objects: size classes of 16, 32, ..., SMALL_MAX_SIZE bytes carved from heap pages,
+//each page starts with a header holding the free bitmap of its objects
+//(requests of 1 KB and more keep the page placement of the fitting strategies)
+#define SMALL_MIN_SIZE 16
+#define SMALL_MAX_SIZE 512
+#define SMALL_CLASSES 6
+#define SMALL_PAGE_MAGIC 0x5A11B10C
+//max number of empty pages kept by one size class
+#define SMALL_EMPTY_PAGES 1
+#define SMALL_BITMAP_WORDS (PAGE_SIZE / SMALL_MIN_SIZE / 32)
+
+struct smallPage{
+	uint32 magic;
+	uint16 sizeClass;
+	//number of free objects in the page
+	uint16 freeObjects;
+	//the pages of the same class having free objects
+	struct smallPage *prev, *next;
+	//bit per object, set if the object is allocated
+	uint32 bitmap[SMALL_BITMAP_WORDS];
+};
+//the objects start after the page header
+#define SMALL_OBJECTS_OFFSET ROUNDUP(sizeof(struct smallPage), SMALL_MIN_SIZE)
+#define smallObjectsPerPage(class) ((PAGE_SIZE - SMALL_OBJECTS_OFFSET) / (SMALL_MIN_SIZE << (class)))
+
+struct smallPage* smallPartialPages[SMALL_CLASSES];
+int smallEmptyPages[SMALL_CLASSES];
 
 
 //my helper global functions
 void* nextFit(uint32 size);
 void* bestFit(uint32 size);
+void* firstFit(uint32 size);
+void* worstFit(uint32 size);
 int searchNextFit(uint32 size);
 int searchBestFit(uint32 size);
 void* heapAlloc(uint32 size, int index);
@@ -36,6 +103,41 @@ inline uint32 pageNumberToHeapVA(int index);
 inline int heapVaToPageNumber(uint32 va);
 inline int abs(int num);
 void updateHeapBlocks(int blockIndex);
+void heapTrim(int blockIndex);
+int searchFirstFit(uint32 size);
+int searchWorstFit(uint32 size);
+int searchNextFitLinear(uint32 size);
+int searchBestFitLinear(uint32 size);
+int searchFirstFitLinear(uint32 size);
+int searchWorstFitLinear(uint32 size);
+void initHeapBlocks();
+int heapBlocksReserve();
+int heapBlockPagesAt(int blockIndex);
+int heapBlockNew(int start, int pages);
+void heapBlockDelete(int n);
+void heapBlockSet(int n, int pages);
+int heapBlockBefore(int tree, int n, int pages, int start);
+void heapBlockUpdate(int tree, int n);
+void heapBlockSplit(int tree, int n, int pages, int start, int* before, int* rest);
+int heapBlockMerge(int tree, int a, int b);
+void heapBlockInsert(int n);
+void heapBlockRemove(int n);
+int heapBlockAt(int start);
+int heapBlockPrior(int start);
+int heapBlockFindFrom(int n, int pages, int fromIndex);
+int heapBlockFindBest(int pages);
+int smallSizeClass(uint32 size);
+void* smallAlloc(uint32 size);
+void smallFree(void* virtual_address);
+struct smallPage* smallNewPage(int sizeClass);
+void smallLinkPage(struct smallPage* page);
+void smallUnlinkPage(struct smallPage* page);
+int isSmallBlock(void* virtual_address);
+void splitHeapBlock(int blockIndex, int pages);
+int growHeapBlock(int blockIndex, int pages);
+int heapTraceBegin();
+void heapTraceEnd(uint8 type, uint32 size, void* virtual_address, void* caller);
+uint32 heapBlockSize(void* virtual_address);
 
 
 // malloc()
@@ -72,6 +174,24 @@ void* malloc(uint32 size)
 	//Use sys_isUHeapPlacementStrategyNEXTFIT() and	sys_isUHeapPlacementStrategyBESTFIT()
 	//to check the current strategy
 
+	//trace the call (if the tracing is on)
+	if(heapTraceBegin()){
+		void* virtual_address = malloc(size);
+		heapTraceEnd(UHT_MALLOC, size, virtual_address, __builtin_return_address(0));
+		return virtual_address;
+	}
+
+	//an empty allocation takes no block (a block of 0 pages would break the free blocks index)
+	if(size == 0)
+		return NULL;
+
+	//small objects share pages
+	if(size <= SMALL_MAX_SIZE)
+		return smallAlloc(size);
+
+	//make sure there is a node for the new block
+	if(!heapBlocksReserve()) return NULL;
+
 	//check the fitting strategy
 	if(sys_isUHeapPlacementStrategyNEXTFIT()){
 		//then apply the NEXT FIT strategy
@@ -79,10 +199,14 @@ void* malloc(uint32 size)
 	}else if(sys_isUHeapPlacementStrategyBESTFIT()){
 		//then apply the BEST FIT strategy
 		return bestFit(ROUNDUP(size, PAGE_SIZE));
+	}else if(sys_isUHeapPlacementStrategyFIRSTFIT()){
+		//then apply the FIRST FIT strategy
+		return firstFit(ROUNDUP(size, PAGE_SIZE));
+	}else if(sys_isUHeapPlacementStrategyWORSTFIT()){
+		//then apply the WORST FIT strategy
+		return worstFit(ROUNDUP(size, PAGE_SIZE));
 	}
 
-	//TODO: [PROJECT 2016 - BONUS2] Apply FIRST FIT and WORST FIT policies
-
 	return NULL;
 }
 
@@ -107,10 +231,24 @@ void free(void* virtual_address)
 	//get the size of the given allocation using its address
 	//you need to call sys_freeMem()
 
+	//trace the call (if the tracing is on)
+	if(heapTraceBegin()){
+		uint32 size = heapBlockSize(virtual_address);
+		free(virtual_address);
+		heapTraceEnd(UHT_FREE, size, virtual_address, __builtin_return_address(0));
+		return;
+	}
+
+	//small objects are not on page boundary
+	if(isSmallBlock(virtual_address)){
+		smallFree(virtual_address);
+		return;
+	}
+
 	//get the size of the block through the given virtual address
 	//first convert the given virtual address to page number
 	int blockIndex = heapVaToPageNumber((uint32) virtual_address);
-	uint32 size = abs(heapBlocks[blockIndex].blockPages) * PAGE_SIZE;
+	uint32 size = abs(heapBlockPagesAt(blockIndex)) * PAGE_SIZE;
 
 	sys_freeMem((uint32) virtual_address , size);
 
@@ -119,6 +257,44 @@ void free(void* virtual_address)
 
 }
 
+
+// malloc_populate():
+//	This function is malloc() that also loads the pages of the allocated block to the working set
+//	(up to its free entries) in the same kernel call, so a block that is used right away (like the
+//	arrays of the sorting programs) doesn't fault on its first access page by page.
+
+void* malloc_populate(uint32 size)
+{
+	heapPopulate = 1;
+	void* virtual_address = malloc(size);
+	heapPopulate = 0;
+
+	return virtual_address;
+}
+
+// calloc():
+//	This function allocates an array of n elements of the given size initialized by 0's
+//	and returns NULL if the total size is 0, overflows or there's no suitable space for it.
+//
+//	The pages of the heap blocks are zero-fill-on-demand, so only the small objects
+//	(that reuse freed space) are cleared here. The pages of a block are not touched,
+//	so the reads of its untouched pages can share the kernel zero frame (command: zeropage).
+
+void *calloc(uint32 n, uint32 size)
+{
+	//an empty array takes no block, then check the overflow of the total size
+	if(n == 0 || size == 0)
+		return NULL;
+	if(n > 0xFFFFFFFF / size)
+		return NULL;
+
+	void* virtual_address = malloc(n * size);
+	if(virtual_address != NULL && isSmallBlock(virtual_address))
+		memset(virtual_address, 0, n * size);
+
+	return virtual_address;
+}
+
 //my helper global functions
 void* nextFit(uint32 size){
 	//NEXT FIT strategy
@@ -146,88 +322,94 @@ void* bestFit(uint32 size){
 	return heapAlloc(size, fitIndex);
 }
 
-int searchNextFit(uint32 size){
-	//validate the size
-	if(size > USER_HEAP_MAX - USER_HEAP_START) return -1;
+void* firstFit(uint32 size){
+	//FIRST FIT strategy
 
-	//search for the next fit space for allocating
-	short firstTime = 1;
-	int blockIndex = NEXT_FIT_INDEX;
-	while(blockIndex != NEXT_FIT_INDEX || firstTime){
-		//check the block reserved or free
+	//first search for the first fit space
+	int fitIndex = searchFirstFit(size);
 
-		//check the heap pages end
-		if(blockIndex == HEAP_PAGES_NUMBER)
-			blockIndex = 0;
+	//check if it found a fit space for allocation
+	if(fitIndex == -1) return NULL;
 
-		if(heapBlocks[blockIndex].blockPages >= (int) (size / PAGE_SIZE))
-			//then there is enough free space for allocating
-			return blockIndex;
-		else if(heapBlocks[blockIndex].blockPages < (int) (size / PAGE_SIZE))
-			//then move to the next block
-			blockIndex += abs(heapBlocks[blockIndex].blockPages);
+	return heapAlloc(size, fitIndex);
+}
 
-		firstTime = 0;
-	}
+void* worstFit(uint32 size){
+	//WORST FIT strategy
 
-	return -1;
+	//first search for the largest free space
+	int fitIndex = searchWorstFit(size);
+
+	//check if it found a fit space for allocation
+	if(fitIndex == -1) return NULL;
+
+	return heapAlloc(size, fitIndex);
+}
+
+int searchNextFit(uint32 size){
+	//validate the size
+	if(size > USER_HEAP_MAX - USER_HEAP_START) return -1;
+	initHeapBlocks();
+
+	//the first free block fitting the size from the next fit index, then from the heap start
+	int fromIndex = NEXT_FIT_INDEX == HEAP_PAGES_NUMBER ? 0 : NEXT_FIT_INDEX;
+	int n = heapBlockFindFrom(heapBlocksRoot[ADDRESS_TREE], size / PAGE_SIZE, fromIndex);
+	if(n == 0) n = heapBlockFindFrom(heapBlocksRoot[ADDRESS_TREE], size / PAGE_SIZE, 0);
+
+	return n == 0 ? -1 : BLOCK(n).start;
 }
 
 int searchBestFit(uint32 size){
 	//validate the size
 	if(size > USER_HEAP_MAX - USER_HEAP_START) return -1;
+	initHeapBlocks();
 
-	//declare variable to hold the best fit blockIndex
-	int bestFitBlockIndex = -1;
+	//the smallest free block fitting the size (the first one on ties)
+	int n = heapBlockFindBest(size / PAGE_SIZE);
+	return n == 0 ? -1 : BLOCK(n).start;
+}
 
-	//start searching for the best fit space
-	//start from the beginning of the virtual memory
-	int blockIndex = 0;
+int searchFirstFit(uint32 size){
+	//validate the size
+	if(size > USER_HEAP_MAX - USER_HEAP_START) return -1;
+	initHeapBlocks();
 
-	while(blockIndex != HEAP_PAGES_NUMBER){
-		//if the current block is free and has the same page number as the size then it is the best block
-		if(heapBlocks[blockIndex].blockPages == (int) (size / PAGE_SIZE))
-			return blockIndex;
-		//else if the current block has enough space for allocating and smaller than the last best block
-		//then make it the best block
-		else if(heapBlocks[blockIndex].blockPages > (int) (size / PAGE_SIZE)){
-			if(bestFitBlockIndex == -1) bestFitBlockIndex = blockIndex;
-			else
-				if(heapBlocks[blockIndex].blockPages < heapBlocks[bestFitBlockIndex].blockPages)
-					bestFitBlockIndex = blockIndex;
-		}
+	int n = heapBlockFindFrom(heapBlocksRoot[ADDRESS_TREE], size / PAGE_SIZE, 0);
+	return n == 0 ? -1 : BLOCK(n).start;
+}
 
-		blockIndex += abs(heapBlocks[blockIndex].blockPages);
-	}
+int searchWorstFit(uint32 size){
+	//validate the size
+	if(size > USER_HEAP_MAX - USER_HEAP_START) return -1;
+	initHeapBlocks();
 
-	return bestFitBlockIndex;
+	//the largest free block (the first one on ties)
+	int root = heapBlocksRoot[ADDRESS_TREE];
+	if(root == 0 || BLOCK(root).maxPages == 0 || BLOCK(root).maxPages < (int) (size / PAGE_SIZE)) return -1;
+	return BLOCK(heapBlockFindBest(BLOCK(root).maxPages)).start;
 }
 
 void* heapAlloc(uint32 size, int index){
 	//allocate the heap pages
 	int pagesNumber = size / PAGE_SIZE;  //pages to allocate
 
-	if(pagesNumber == heapBlocks[index].blockPages)
-		heapBlocks[index].blockPages *= -1;
-	else if (pagesNumber < heapBlocks[index].blockPages) {
-		heapBlocks[index + pagesNumber].blockPages
-				= heapBlocks[index].blockPages - pagesNumber;
-		heapBlocks[index].blockPages = pagesNumber * -1;
-		//set the prior index for free function
-		heapBlocks[index + pagesNumber].priorBlockIndex = index;
-		//update the after next prior to the next block
-		if(index + pagesNumber + heapBlocks[index + pagesNumber].blockPages != HEAP_PAGES_NUMBER)
-			heapBlocks[index + pagesNumber + heapBlocks[index + pagesNumber].blockPages].priorBlockIndex
-					= index + pagesNumber;
-	}
+	//the free block becomes allocated, its rest (if any) is a new free block
+	int n = heapBlockAt(index);
+	int blockPages = BLOCK(n).pages;
+	heapBlockSet(n, pagesNumber * -1);
+	if(pagesNumber < blockPages)
+		heapBlockInsert(heapBlockNew(index + pagesNumber, blockPages - pagesNumber));
 
 	//update the global pointers
 	NEXT_FIT_INDEX = index + pagesNumber;
 	NEXT_FIT_PTR = pageNumberToHeapVA(index + pagesNumber);
 
-	//allocate the pages on the page file
+	//allocate the pages on the page file (and load them if they are populated)
 	uint32 startVA = pageNumberToHeapVA(index);
-	sys_allocateMem(startVA, size);
+	if(heapPopulate)
+		sys_allocateMem_prefault(startVA, size);
+	else
+		sys_allocateMem(startVA, size);
 
 	//return start virtual address
 	return (void*) startVA;
@@ -250,61 +432,61 @@ inline int heapVaToPageNumber(uint32 va){
 
 void updateHeapBlocks(int blockIndex) {
 	//NOTE: we can not find allocated block between two free blocks
-	int priorBlockIndex = heapBlocks[blockIndex].priorBlockIndex;
-	int nextBlockIndex = blockIndex + abs(heapBlocks[blockIndex].blockPages);
-	//first check the prior block if it is free then join to it
-	if (blockIndex != 0 && nextBlockIndex != HEAP_PAGES_NUMBER
-			&& heapBlocks[priorBlockIndex].blockPages > 0
-			&& heapBlocks[nextBlockIndex].blockPages > 0) {
-		//combine the three free blocks as a one free block
-		//update the beginning
-		heapBlocks[priorBlockIndex].blockPages += abs(
-				heapBlocks[blockIndex].blockPages)
-				+ heapBlocks[nextBlockIndex].blockPages;
-		//remove the combined blocks
-		heapBlocks[blockIndex].blockPages = 0;
-		heapBlocks[blockIndex].priorBlockIndex = 0;
-		heapBlocks[nextBlockIndex].blockPages = 0;
-		heapBlocks[nextBlockIndex].priorBlockIndex = 0;
-		//update the next block prior if exist
-		//check if the next block exist or not
-		if(priorBlockIndex + heapBlocks[priorBlockIndex].blockPages != HEAP_PAGES_NUMBER)
-			heapBlocks[priorBlockIndex + heapBlocks[priorBlockIndex].blockPages].priorBlockIndex
-			 = priorBlockIndex;
-	} else if (heapBlocks[priorBlockIndex].blockPages > 0 && blockIndex != 0) {
-		////combine the three free blocks as a one free block
-		//then the prior block is free block
-		heapBlocks[priorBlockIndex].blockPages += abs(
-				heapBlocks[blockIndex].blockPages);
-		//remove the combined block
-		heapBlocks[blockIndex].blockPages = 0;
-		heapBlocks[blockIndex].priorBlockIndex = 0;
-		//update the next block prior if exist
-		//check if the next block exist or not
-		if(priorBlockIndex + heapBlocks[priorBlockIndex].blockPages != HEAP_PAGES_NUMBER)
-			heapBlocks[priorBlockIndex + heapBlocks[priorBlockIndex].blockPages].priorBlockIndex
-			= priorBlockIndex;
-	} else if (heapBlocks[nextBlockIndex].blockPages > 0 && nextBlockIndex
-			!= HEAP_PAGES_NUMBER) {
-		//combine the three free blocks as a one free block
-		//then the next block is free block
-		heapBlocks[blockIndex].blockPages = abs(
-				heapBlocks[blockIndex].blockPages)
-				+ heapBlocks[nextBlockIndex].blockPages;
-		//remove the combined block
-		heapBlocks[nextBlockIndex].blockPages = 0;
-		heapBlocks[nextBlockIndex].priorBlockIndex = 0;
-		//update the next block prior if exist
-		//check if the next block exist or not
-		if(blockIndex + heapBlocks[blockIndex].blockPages != HEAP_PAGES_NUMBER)
-			heapBlocks[blockIndex + heapBlocks[blockIndex].blockPages].priorBlockIndex
-			= blockIndex;
-	} else {
-		heapBlocks[blockIndex].blockPages *= -1;
+	int n = heapBlockAt(blockIndex);
+	int freeIndex = blockIndex;
+	int freePages = abs(BLOCK(n).pages);
+	uint32 freedPages = freePages;
+	int nextBlockIndex = blockIndex + freePages;
+	heapBlockRemove(n);
+
+	//join the next block if it is free
+	if(nextBlockIndex != HEAP_PAGES_NUMBER){
+		int next = heapBlockAt(nextBlockIndex);
+		if(BLOCK(next).pages > 0){
+			freePages += BLOCK(next).pages;
+			heapBlockRemove(next);
+			heapBlockDelete(next);
+		}
 	}
 
-	//cprintf("index = %d, add = %x, #pages = %d\n", blockIndex, pageNumberToHeapVA(blockIndex), heapBlocks[blockIndex].blockPages);
+	//join the prior block if it is free
+	if(blockIndex != 0){
+		int prior = heapBlockPrior(blockIndex);
+		if(BLOCK(prior).pages > 0){
+			freeIndex = BLOCK(prior).start;
+			freePages += BLOCK(prior).pages;
+			heapBlockRemove(prior);
+			heapBlockDelete(prior);
+		}
+	}
 
+	//the joined block takes the node of the freed block
+	BLOCK(n).start = freeIndex;
+	BLOCK(n).pages = freePages;
+	heapBlockInsert(n);
+
+	//the next fit index must stay at the start of a block
+	if(NEXT_FIT_INDEX > freeIndex && NEXT_FIT_INDEX < freeIndex + freePages){
+		NEXT_FIT_INDEX = freeIndex;
+		NEXT_FIT_PTR = pageNumberToHeapVA(freeIndex);
+	}
+
+	//cprintf("index = %d, add = %x, #pages = %d\n", blockIndex, pageNumberToHeapVA(blockIndex), freePages);
+
+	//after a burst of frees reaching the free tail of the heap, the kernel releases its tables
+	//(the holes between the blocks keep theirs, they are likely to be allocated again)
+	heapUntrimmedPages += freedPages;
+	if(heapUntrimmedPages >= HEAP_TRIM_THRESHOLD && freeIndex + freePages == HEAP_PAGES_NUMBER){
+		heapUntrimmedPages = 0;
+		heapTrim(freeIndex);
+	}
+}
+
+//give the 4 MB spans of the free tail block starting at the given page back to the kernel
+void heapTrim(int blockIndex){
+	uint32 start = pageNumberToHeapVA(blockIndex);
+	if(ROUNDUP(start, PTSIZE) + PTSIZE <= USER_HEAP_MAX)
+		sys_trimMem(start, USER_HEAP_MAX - start);
 }
 
 //=================================================================================//
@@ -329,6 +511,515 @@ void *realloc(void *virtual_address, uint32 new_size)
 {
 	//TODO: [PROJECT 2016 - BONUS4] realloc() [User Side]
 	// Write your code here, remove the panic and write your code
-	panic("realloc() is not implemented yet...!!");
+	//panic("realloc() is not implemented yet...!!");
+
+	//trace the call (if the tracing is on)
+	if(heapTraceBegin()){
+		void* new_virtual_address = realloc(virtual_address, new_size);
+		heapTraceEnd(UHT_REALLOC, new_size, new_virtual_address, __builtin_return_address(0));
+		return new_virtual_address;
+	}
+
+	if(virtual_address == NULL) return malloc(new_size);
+	if(new_size == 0){
+		free(virtual_address);
+		return NULL;
+	}
+
+	//a small object is moved unless its size class still fits
+	if(isSmallBlock(virtual_address)){
+		uint32 oldSize = SMALL_MIN_SIZE << ((struct smallPage*) ROUNDDOWN((uint32) virtual_address, PAGE_SIZE))->sizeClass;
+		if(new_size <= oldSize && (new_size > oldSize / 2 || oldSize == SMALL_MIN_SIZE))
+			return virtual_address;
+
+		void* newVA = malloc(new_size);
+		if(newVA == NULL) return virtual_address;
+		memcpy(newVA, virtual_address, new_size < oldSize ? new_size : oldSize);
+		free(virtual_address);
+		return newVA;
+	}
+
+	int blockIndex = heapVaToPageNumber((uint32) virtual_address);
+	int oldPages = abs(heapBlockPagesAt(blockIndex));
+	int newPages = ROUNDUP(new_size, PAGE_SIZE) / PAGE_SIZE;
+
+	//the internal fragment is enough
+	if(newPages == oldPages) return virtual_address;
+
+	//shrink in place, the tail becomes a free block
+	if(newPages < oldPages){
+		if(!heapBlocksReserve()) return virtual_address;
+		sys_freeMem((uint32) virtual_address + newPages * PAGE_SIZE, (oldPages - newPages) * PAGE_SIZE);
+		splitHeapBlock(blockIndex, newPages);
+		updateHeapBlocks(blockIndex + newPages);
+		return virtual_address;
+	}
+
+	//grow in place if the next block is free and big enough
+	if(growHeapBlock(blockIndex, newPages)){
+		sys_allocateMem((uint32) virtual_address + oldPages * PAGE_SIZE, (newPages - oldPages) * PAGE_SIZE);
+		return virtual_address;
+	}
+
+	//move it, the pages are moved by the kernel without copying them
+	void* newVA = malloc(new_size);
+	//no space, keep the block where it is
+	if(newVA == NULL) return virtual_address;
+	sys_moveMem((uint32) virtual_address, (uint32) newVA, oldPages * PAGE_SIZE);
+	free(virtual_address);
+	return newVA;
+}
+
+//split an allocated block into an allocated block of the given pages and an allocated block of the rest
+void splitHeapBlock(int blockIndex, int pages){
+	int n = heapBlockAt(blockIndex);
+	int blockPages = abs(BLOCK(n).pages);
+
+	heapBlockSet(n, pages * -1);
+	heapBlockInsert(heapBlockNew(blockIndex + pages, (blockPages - pages) * -1));
+}
+
+//extend an allocated block to the given pages using the free block after it, returns 0 if it is not possible
+int growHeapBlock(int blockIndex, int pages){
+	int n = heapBlockAt(blockIndex);
+	int oldPages = abs(BLOCK(n).pages);
+	int freeIndex = blockIndex + oldPages;
+	if(freeIndex == HEAP_PAGES_NUMBER) return 0;
+
+	int f = heapBlockAt(freeIndex);
+	if(BLOCK(f).pages < pages - oldPages) return 0;
+
+	int restIndex = blockIndex + pages;
+	int restPages = BLOCK(f).pages - (pages - oldPages);
+	heapBlockRemove(f);
+	heapBlockSet(n, pages * -1);
+
+	//the rest of the free block keeps its node
+	if(restPages != 0){
+		BLOCK(f).start = restIndex;
+		BLOCK(f).pages = restPages;
+		heapBlockInsert(f);
+	}
+	else heapBlockDelete(f);
+
+	//the next fit pointer must stay at the start of a block
+	if(NEXT_FIT_INDEX > blockIndex && NEXT_FIT_INDEX < restIndex){
+		NEXT_FIT_INDEX = restIndex;
+		NEXT_FIT_PTR = pageNumberToHeapVA(restIndex);
+	}
+	return 1;
+}
+
+//==================================================================================//
+//================================ HEAP BLOCKS INDEX ===============================//
+//==================================================================================//
+
+//the linear scans of the heap blocks, they give the reference decisions of the indexed searches
+
+int searchNextFitLinear(uint32 size){
+	//validate the size
+	if(size > USER_HEAP_MAX - USER_HEAP_START) return -1;
+	initHeapBlocks();
+
+	//search for the next fit space for allocating
+	short firstTime = 1;
+	int blockIndex = NEXT_FIT_INDEX;
+	while(blockIndex != NEXT_FIT_INDEX || firstTime){
+		//check the block reserved or free
+
+		//check the heap pages end
+		if(blockIndex == HEAP_PAGES_NUMBER){
+			blockIndex = 0;
+			//the whole heap is searched if the scan started at its beginning
+			if(NEXT_FIT_INDEX == 0) break;
+		}
+
+		if(heapBlockPagesAt(blockIndex) >= (int) (size / PAGE_SIZE))
+			//then there is enough free space for allocating
+			return blockIndex;
+		else if(heapBlockPagesAt(blockIndex) < (int) (size / PAGE_SIZE))
+			//then move to the next block
+			blockIndex += abs(heapBlockPagesAt(blockIndex));
+
+		firstTime = 0;
+	}
+
+	return -1;
+}
+
+int searchBestFitLinear(uint32 size){
+	//validate the size
+	if(size > USER_HEAP_MAX - USER_HEAP_START) return -1;
+	initHeapBlocks();
+
+	//declare variable to hold the best fit blockIndex
+	int bestFitBlockIndex = -1;
+
+	//start searching for the best fit space
+	//start from the beginning of the virtual memory
+	int blockIndex = 0;
+
+	while(blockIndex != HEAP_PAGES_NUMBER){
+		//if the current block is free and has the same page number as the size then it is the best block
+		if(heapBlockPagesAt(blockIndex) == (int) (size / PAGE_SIZE))
+			return blockIndex;
+		//else if the current block has enough space for allocating and smaller than the last best block
+		//then make it the best block
+		else if(heapBlockPagesAt(blockIndex) > (int) (size / PAGE_SIZE)){
+			if(bestFitBlockIndex == -1) bestFitBlockIndex = blockIndex;
+			else
+				if(heapBlockPagesAt(blockIndex) < heapBlockPagesAt(bestFitBlockIndex))
+					bestFitBlockIndex = blockIndex;
+		}
+
+		blockIndex += abs(heapBlockPagesAt(blockIndex));
+	}
+
+	return bestFitBlockIndex;
+}
+
+int searchFirstFitLinear(uint32 size){
+	//validate the size
+	if(size > USER_HEAP_MAX - USER_HEAP_START) return -1;
+	initHeapBlocks();
+
+	int blockIndex = 0;
+	while(blockIndex != HEAP_PAGES_NUMBER){
+		if(heapBlockPagesAt(blockIndex) >= (int) (size / PAGE_SIZE))
+			return blockIndex;
+		blockIndex += abs(heapBlockPagesAt(blockIndex));
+	}
+	return -1;
+}
+
+int searchWorstFitLinear(uint32 size){
+	//validate the size
+	if(size > USER_HEAP_MAX - USER_HEAP_START) return -1;
+	initHeapBlocks();
+
+	int worstFitBlockIndex = -1;
+	int blockIndex = 0;
+	while(blockIndex != HEAP_PAGES_NUMBER){
+		if(heapBlockPagesAt(blockIndex) >= (int) (size / PAGE_SIZE)
+				&& (worstFitBlockIndex == -1 || heapBlockPagesAt(blockIndex) > heapBlockPagesAt(worstFitBlockIndex)))
+			worstFitBlockIndex = blockIndex;
+		blockIndex += abs(heapBlockPagesAt(blockIndex));
+	}
+	return worstFitBlockIndex;
+}
+
+//the whole heap is one free block before the first allocation
+void initHeapBlocks(){
+	if(heapBlocksReady) return;
+	heapBlocksReady = 1;
+	heapBlockInsert(heapBlockNew(0, HEAP_PAGES_NUMBER));
+}
+
+//make sure the next heap operation finds a free node, returns 0 if there is none
+int heapBlocksReserve(){
+	initHeapBlocks();
+
+	//one operation takes at most one new node, so a new chunk is taken before the last node is used
+	int available = unusedHeapBlocksNumber + heapBlockChunksNumber * HEAP_BLOCKS_PER_CHUNK - newHeapBlocks;
+	if(available >= 2 || heapBlocksRefilling || heapBlockChunksNumber == MAX_HEAP_BLOCK_CHUNKS)
+		return available >= 1;
+
+	//the chunk is a normal allocated block, its malloc() takes the last node if needed
+	heapBlocksRefilling = 1;
+	struct heapBlock* chunk = malloc(HEAP_BLOCKS_CHUNK_SIZE);
+	heapBlocksRefilling = 0;
+	if(chunk != NULL) heapBlockChunks[heapBlockChunksNumber++] = chunk;
+
+	available = unusedHeapBlocksNumber + heapBlockChunksNumber * HEAP_BLOCKS_PER_CHUNK - newHeapBlocks;
+	return available >= 1;
+}
+
+//the pages of the block starting at the given page (> 0 for a free block, < 0 for an allocated block)
+int heapBlockPagesAt(int blockIndex){
+	initHeapBlocks();
+	return BLOCK(heapBlockAt(blockIndex)).pages;
+}
+
+int heapBlockNew(int start, int pages){
+	int n = unusedHeapBlocks;
+	if(n != 0){
+		unusedHeapBlocks = BLOCK(n).left[ADDRESS_TREE];
+		unusedHeapBlocksNumber--;
+	}
+	else n = newHeapBlocks++;
+
+	heapBlocksSeed = heapBlocksSeed * 1103515245 + 12345;
+	BLOCK(n).priority = heapBlocksSeed >> 16;
+	BLOCK(n).start = start;
+	BLOCK(n).pages = pages;
+	return n;
+}
+
+void heapBlockDelete(int n){
+	BLOCK(n).left[ADDRESS_TREE] = unusedHeapBlocks;
+	unusedHeapBlocks = n;
+	unusedHeapBlocksNumber++;
+}
+
+//change the pages of the block n in its place
+void heapBlockSet(int n, int pages){
+	heapBlockRemove(n);
+	BLOCK(n).pages = pages;
+	heapBlockInsert(n);
+}
+
+//is node n ordered before the key (pages, start) in the given tree?
+int heapBlockBefore(int tree, int n, int pages, int start){
+	if(tree == SIZE_TREE && BLOCK(n).pages != pages)
+		return BLOCK(n).pages < pages;
+	return BLOCK(n).start < start;
+}
+
+void heapBlockUpdate(int tree, int n){
+	if(tree != ADDRESS_TREE) return;
+	//allocated blocks have no free pages
+	int max = BLOCK(n).pages > 0 ? BLOCK(n).pages : 0;
+	int l = BLOCK(n).left[ADDRESS_TREE], r = BLOCK(n).right[ADDRESS_TREE];
+	if(l != 0 && BLOCK(l).maxPages > max) max = BLOCK(l).maxPages;
+	if(r != 0 && BLOCK(r).maxPages > max) max = BLOCK(r).maxPages;
+	BLOCK(n).maxPages = max;
+}
+
+//split the subtree n into the nodes ordered before the key (pages, start) and the rest
+void heapBlockSplit(int tree, int n, int pages, int start, int* before, int* rest){
+	if(n == 0){
+		*before = *rest = 0;
+		return;
+	}
+	if(heapBlockBefore(tree, n, pages, start)){
+		heapBlockSplit(tree, BLOCK(n).right[tree], pages, start, &BLOCK(n).right[tree], rest);
+		*before = n;
+	}
+	else{
+		heapBlockSplit(tree, BLOCK(n).left[tree], pages, start, before, &BLOCK(n).left[tree]);
+		*rest = n;
+	}
+	heapBlockUpdate(tree, n);
+}
+
+//merge two subtrees, all nodes of a are ordered before the nodes of b
+int heapBlockMerge(int tree, int a, int b){
+	if(a == 0) return b;
+	if(b == 0) return a;
+	if(BLOCK(a).priority > BLOCK(b).priority){
+		BLOCK(a).right[tree] = heapBlockMerge(tree, BLOCK(a).right[tree], b);
+		heapBlockUpdate(tree, a);
+		return a;
+	}
+	BLOCK(b).left[tree] = heapBlockMerge(tree, a, BLOCK(b).left[tree]);
+	heapBlockUpdate(tree, b);
+	return b;
+}
+
+//every block is in the ADDRESS tree, only the free blocks are in the SIZE tree
+void heapBlockInsert(int n){
+	int tree, before, rest;
+	if(BLOCK(n).pages > 0) heapFreePages += BLOCK(n).pages;
+	for(tree = ADDRESS_TREE; tree <= (BLOCK(n).pages > 0 ? SIZE_TREE : ADDRESS_TREE); tree++){
+		BLOCK(n).left[tree] = BLOCK(n).right[tree] = 0;
+		heapBlockUpdate(tree, n);
+		heapBlockSplit(tree, heapBlocksRoot[tree], BLOCK(n).pages, BLOCK(n).start, &before, &rest);
+		heapBlocksRoot[tree] = heapBlockMerge(tree, heapBlockMerge(tree, before, n), rest);
+	}
+}
+
+void heapBlockRemove(int n){
+	int tree, before, node, rest;
+	if(BLOCK(n).pages > 0) heapFreePages -= BLOCK(n).pages;
+	for(tree = ADDRESS_TREE; tree <= (BLOCK(n).pages > 0 ? SIZE_TREE : ADDRESS_TREE); tree++){
+		heapBlockSplit(tree, heapBlocksRoot[tree], BLOCK(n).pages, BLOCK(n).start, &before, &rest);
+		heapBlockSplit(tree, rest, BLOCK(n).pages, BLOCK(n).start + 1, &node, &rest);
+		heapBlocksRoot[tree] = heapBlockMerge(tree, before, rest);
+	}
+}
+
+//the node of the block starting at the given page
+int heapBlockAt(int start){
+	int n = heapBlocksRoot[ADDRESS_TREE];
+	while(n != 0 && BLOCK(n).start != start)
+		n = (start < BLOCK(n).start) ? BLOCK(n).left[ADDRESS_TREE] : BLOCK(n).right[ADDRESS_TREE];
+	if(n == 0) panic("uheap: no block starts at page %d", start);
+	return n;
+}
+
+//the node of the block just before the one starting at the given page
+int heapBlockPrior(int start){
+	int n = heapBlocksRoot[ADDRESS_TREE], found = 0;
+	while(n != 0){
+		if(BLOCK(n).start < start){
+			found = n;
+			n = BLOCK(n).right[ADDRESS_TREE];
+		}
+		else n = BLOCK(n).left[ADDRESS_TREE];
+	}
+	return found;
+}
+
+//the lowest free block of the subtree n starting at fromIndex or after it with at least the given pages
+int heapBlockFindFrom(int n, int pages, int fromIndex){
+	if(n == 0 || BLOCK(n).maxPages < pages) return 0;
+	heapSearchSteps++;
+
+	//n and its whole left subtree start before fromIndex
+	if(BLOCK(n).start < fromIndex)
+		return heapBlockFindFrom(BLOCK(n).right[ADDRESS_TREE], pages, fromIndex);
+
+	int found = heapBlockFindFrom(BLOCK(n).left[ADDRESS_TREE], pages, fromIndex);
+	if(found != 0) return found;
+	if(BLOCK(n).pages >= pages) return n;
+	return heapBlockFindFrom(BLOCK(n).right[ADDRESS_TREE], pages, fromIndex);
+}
+
+//the smallest free block with at least the given pages (the lowest one on ties)
+int heapBlockFindBest(int pages){
+	int n = heapBlocksRoot[SIZE_TREE], found = 0;
+	while(n != 0){
+		heapSearchSteps++;
+		if(BLOCK(n).pages >= pages){
+			found = n;
+			n = BLOCK(n).left[SIZE_TREE];
+		}
+		else n = BLOCK(n).right[SIZE_TREE];
+	}
+	return found;
+}
+//==================================================================================//
+//==================================== TRACING =====================================//
+//==================================================================================//
+
+//returns 1 if the current call is traced (the tracing is on and it's not a nested call),
+//the call is done again inside the tracing and the event is recorded by heapTraceEnd()
+int heapTraceBegin(){
+	if(heapTracing == -1)
+		heapTracing = sys_uheap_trace(NULL);
+	if(!heapTracing || heapTraceDepth > 0)
+		return 0;
+
+	heapTraceDepth++;
+	heapSearchSteps = 0;
+	return 1;
+}
+
+void heapTraceEnd(uint8 type, uint32 size, void* virtual_address, void* caller){
+	heapTraceDepth--;
+	initHeapBlocks();
+
+	struct uheapTraceEvent event;
+	event.type = type;
+	event.strategy = sys_isUHeapPlacementStrategyFIRSTFIT() ? UHP_PLACE_FIRSTFIT :
+			sys_isUHeapPlacementStrategyBESTFIT() ? UHP_PLACE_BESTFIT :
+			sys_isUHeapPlacementStrategyNEXTFIT() ? UHP_PLACE_NEXTFIT : UHP_PLACE_WORSTFIT;
+	event.searchSteps = heapSearchSteps > 0xFFFF ? 0xFFFF : heapSearchSteps;
+	event.size = size;
+	event.address = (uint32) virtual_address;
+	event.caller = (uint32) caller;
+	event.freePages = heapFreePages;
+	event.largestFreePages = BLOCK(heapBlocksRoot[ADDRESS_TREE]).maxPages;
+	sys_uheap_trace(&event);
+}
+
+//the size of the allocation at the given address (the size class of a small object)
+uint32 heapBlockSize(void* virtual_address){
+	if(virtual_address == NULL) return 0;
+	if(isSmallBlock(virtual_address))
+		return SMALL_MIN_SIZE << ((struct smallPage*) ROUNDDOWN((uint32) virtual_address, PAGE_SIZE))->sizeClass;
+	return abs(heapBlockPagesAt(heapVaToPageNumber((uint32) virtual_address))) * PAGE_SIZE;
+}
+
+//==================================================================================//
+//================================= SMALL OBJECTS ==================================//
+//==================================================================================//
+
+//the smallest size class holding size bytes
+int smallSizeClass(uint32 size){
+	int sizeClass = 0;
+	while((SMALL_MIN_SIZE << sizeClass) < size) sizeClass++;
+	return sizeClass;
+}
+
+int isSmallBlock(void* virtual_address){
+	//page blocks are on page boundary, small objects never are (the page header is there)
+	if((uint32) virtual_address % PAGE_SIZE == 0) return 0;
+	return ((struct smallPage*) ROUNDDOWN((uint32) virtual_address, PAGE_SIZE))->magic == SMALL_PAGE_MAGIC;
+}
+
+void* smallAlloc(uint32 size){
+	int sizeClass = smallSizeClass(size);
+
+	//no page of this class has free objects, take a new page from the heap
+	struct smallPage* page = smallPartialPages[sizeClass];
+	if(page == NULL){
+		page = smallNewPage(sizeClass);
+		if(page == NULL) return NULL;
+	}
+
+	//find a free object in the bitmap
+	int word = 0;
+	while(page->bitmap[word] == 0xFFFFFFFF) word++;
+	int bit = 0;
+	while(page->bitmap[word] & (1U << bit)) bit++;
+	page->bitmap[word] |= (1U << bit);
+
+	if(page->freeObjects-- == smallObjectsPerPage(sizeClass)) smallEmptyPages[sizeClass]--;
+	//a full page leaves the partial pages list
+	if(page->freeObjects == 0) smallUnlinkPage(page);
+
+	return (char*) page + SMALL_OBJECTS_OFFSET + (word * 32 + bit) * (SMALL_MIN_SIZE << sizeClass);
+}
+
+void smallFree(void* virtual_address){
+	struct smallPage* page = (struct smallPage*) ROUNDDOWN((uint32) virtual_address, PAGE_SIZE);
+	int sizeClass = page->sizeClass;
+	int object = ((uint32) virtual_address - (uint32) page - SMALL_OBJECTS_OFFSET) / (SMALL_MIN_SIZE << sizeClass);
+
+	//a full page has a free object again
+	if(page->freeObjects == 0) smallLinkPage(page);
+	page->bitmap[object / 32] &= ~(1U << (object % 32));
+	page->freeObjects++;
+
+	if(page->freeObjects == smallObjectsPerPage(sizeClass)){
+		//keep few empty pages, give the rest back to the heap
+		if(smallEmptyPages[sizeClass] == SMALL_EMPTY_PAGES){
+			smallUnlinkPage(page);
+			page->magic = 0;
+			free(page);
+		}
+		else smallEmptyPages[sizeClass]++;
+	}
+}
+
+struct smallPage* smallNewPage(int sizeClass){
+	struct smallPage* page = malloc(PAGE_SIZE);
+	if(page == NULL) return NULL;
+
+	page->magic = SMALL_PAGE_MAGIC;
+	page->sizeClass = sizeClass;
+	page->freeObjects = smallObjectsPerPage(sizeClass);
+
+	//the bits after the last object are always set
+	int i;
+	for(i = 0; i < SMALL_BITMAP_WORDS; i++) page->bitmap[i] = 0;
+	for(i = page->freeObjects; i < SMALL_BITMAP_WORDS * 32; i++) page->bitmap[i / 32] |= (1U << (i % 32));
+
+	smallLinkPage(page);
+	smallEmptyPages[sizeClass]++;
+	return page;
+}
+
+void smallLinkPage(struct smallPage* page){
+	page->prev = NULL;
+	page->next = smallPartialPages[page->sizeClass];
+	if(page->next != NULL) page->next->prev = page;
+	smallPartialPages[page->sizeClass] = page;
+}
 
+void smallUnlinkPage(struct smallPage* page){
+	if(page->prev != NULL) page->prev->next = page->next;
+	else smallPartialPages[page->sizeClass] = page->next;
+	if(page->next != NULL) page->next->prev = page->prev;
 }
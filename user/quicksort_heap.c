@@ -29,7 +29,8 @@ void _main(void)
 
 		readline("Enter the number of elements: ", Line);
 		int NumOfElements = strtol(Line, NULL, 10) ;
-		int *Elements = malloc(sizeof(int) * NumOfElements) ;
+		//the array is initialized right away, so its pages are loaded with the allocation
+		int *Elements = malloc_populate(sizeof(int) * NumOfElements) ;
 		cprintf("Chose the initialization method:\n") ;
 		cprintf("a) Ascending\n") ;
 		cprintf("b) Descending\n") ;
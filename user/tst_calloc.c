@@ -0,0 +1,58 @@
+/* *********************************************************** */
+/* Tests calloc(): the array is zeroed, the sparse reads of a  */
+/* large array share the zero frame (command: zeropage) and a  */
+/* write gives the page its private frame (copy on write)      */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+void _main(void)
+{
+	int Mega = 1024*1024;
+	int i;
+
+	cprintf("This test has THREE cases and requires the zero page sharing (command: zeropage).\n");
+
+	/*CASE1: small objects are zeroed even when they reuse freed space*/
+	char* small = malloc(100);
+	for (i = 0; i < 100; i++) small[i] = 'x';
+	free(small);
+	small = calloc(25, 4);
+	for (i = 0; i < 100; i++)
+		if (small[i] != 0) panic("Wrong calloc: the small object is not zeroed");
+	free(small);
+	if (calloc(Mega, 8*Mega) != NULL) panic("Wrong calloc: the overflowed size is allocated");
+	if (calloc(0, 100) != NULL || calloc(100, 0) != NULL || calloc(0, 0) != NULL) panic("Wrong calloc: an empty array takes a block");
+	cprintf("CASE1: (small objects are zeroed) is succeeded...\n") ;
+
+	/*CASE2: the sparse reads of a large array take no frames and no page file slots*/
+	int usedDiskPages = sys_pf_calculate_allocated_pages() ;
+	int* arr = calloc(4*Mega, sizeof(int));
+	if (arr == NULL) panic("Wrong calloc: no space for 16 MB");
+	uint32 tables = (ROUNDUP((uint32) arr + 16*Mega, PTSIZE) - ROUNDDOWN((uint32) arr, PTSIZE)) / PTSIZE;
+
+	int freeFrames = sys_calculate_free_frames() ;
+	//one read every 16 pages, more pages than the working set
+	for (i = 0; i < 4*Mega; i += 16*PAGE_SIZE/sizeof(int))
+		if (arr[i] != 0) panic("Wrong calloc: the array is not zeroed");
+	//only the page tables of the array are allocated
+	if ((freeFrames - sys_calculate_free_frames()) > tables) panic("Wrong sparse read: pages are allocated in memory");
+	//the read pages are not written to the page file at their eviction
+	if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 16*Mega/PAGE_SIZE) panic("Extra or less pages are allocated in PageFile");
+	cprintf("CASE2: (sparse reads share the zero frame) is succeeded...\n") ;
+
+	/*CASE3: a write gives the page its private frame, the other pages stay zeroed*/
+	freeFrames = sys_calculate_free_frames() ;
+	arr[0] = 1;
+	if ((freeFrames - sys_calculate_free_frames()) != 1) panic("Wrong copy on write: extra or less frames are allocated");
+	for (i = 0; i < 4*Mega; i += 16*PAGE_SIZE/sizeof(int))
+		if (arr[i] != (i == 0 ? 1 : 0)) panic("Wrong copy on write: stored values are wrongly changed!");
+
+	free(arr);
+	if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 0) panic("Wrong free: Extra or less pages are removed from PageFile");
+	cprintf("CASE3: (copy on write of the zero frame) is succeeded...\n") ;
+
+	cprintf("Congratulations!! test calloc completed successfully.\n");
+
+	return;
+}
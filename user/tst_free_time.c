@@ -0,0 +1,46 @@
+/* *********************************************************** */
+/* Measures the cost of free() versus the size of the block,   */
+/* for untouched blocks and for blocks with touched pages      */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+void _main(void)
+{
+	int kilo = 1024;
+	int Mega = 1024*1024;
+	uint32 size, i;
+
+	cprintf("size (KB)\tfree (untouched)\tfree (touched)\n");
+	for (size = 4*kilo; size <= 256*Mega; size *= 4)
+	{
+		//[1] a block that has no page in memory or in the page file
+		int freeFrames = sys_calculate_free_frames() ;
+		char* block = malloc(size);
+		if (block == NULL) panic("Wrong allocation: no space for %d KB", size / kilo);
+
+		struct uint64 start = sys_get_virtual_time();
+		free(block);
+		uint32 untouchedTime = get_virtual_time_since(start);
+
+		//the disk tables of the 4 MB spans inside the block are removed, only the tables of
+		//its two partial spans may be kept (and a new chunk of the heap blocks)
+		if ((freeFrames - sys_calculate_free_frames()) > 3)
+			panic("Wrong free: %d frames of the %d KB block are not freed", freeFrames - sys_calculate_free_frames(), size / kilo);
+
+		//[2] a block with its first pages touched, they are in the working set or in the page file
+		block = malloc(size);
+		if (block == NULL) panic("Wrong allocation: no space for %d KB", size / kilo);
+		for (i = 0; i < size && i < 4*Mega; i += PAGE_SIZE) block[i] = 1;	//at most 4 MB, the page file is limited
+
+		start = sys_get_virtual_time();
+		free(block);
+		uint32 touchedTime = get_virtual_time_since(start);
+
+		cprintf("%d\t\t%d\t\t\t%d\n", size / kilo, untouchedTime, touchedTime);
+	}
+
+	cprintf("Congratulations!! free time measurement completed.\n");
+
+	return;
+}
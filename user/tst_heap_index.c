@@ -0,0 +1,85 @@
+/* *********************************************************** */
+/* Compares the indexed free block searches of the user heap   */
+/* with the linear scans of the heap blocks after random       */
+/* malloc and free operations, all the decisions must match    */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+//the searches of lib/uheap.c
+extern int searchNextFit(uint32 size);
+extern int searchBestFit(uint32 size);
+extern int searchFirstFit(uint32 size);
+extern int searchWorstFit(uint32 size);
+extern int searchNextFitLinear(uint32 size);
+extern int searchBestFitLinear(uint32 size);
+extern int searchFirstFitLinear(uint32 size);
+extern int searchWorstFitLinear(uint32 size);
+
+#define NUM_OF_BLOCKS 200
+
+int checks = 0;
+
+void checkSearches(uint32 size)
+{
+	if (searchNextFit(size) != searchNextFitLinear(size)) panic("NEXT FIT: indexed search (%d) != linear scan (%d) for %d pages", searchNextFit(size), searchNextFitLinear(size), size / PAGE_SIZE);
+	if (searchBestFit(size) != searchBestFitLinear(size)) panic("BEST FIT: indexed search (%d) != linear scan (%d) for %d pages", searchBestFit(size), searchBestFitLinear(size), size / PAGE_SIZE);
+	if (searchFirstFit(size) != searchFirstFitLinear(size)) panic("FIRST FIT: indexed search (%d) != linear scan (%d) for %d pages", searchFirstFit(size), searchFirstFitLinear(size), size / PAGE_SIZE);
+	if (searchWorstFit(size) != searchWorstFitLinear(size)) panic("WORST FIT: indexed search (%d) != linear scan (%d) for %d pages", searchWorstFit(size), searchWorstFitLinear(size), size / PAGE_SIZE);
+	checks++;
+}
+
+void _main(void)
+{
+	void* ptr_allocations[NUM_OF_BLOCKS] = {0};
+	uint32 seed = 7, pages, checkPages;
+	int i;
+
+	int usedDiskPages = sys_pf_calculate_allocated_pages() ;
+
+	//an empty allocation takes no block and leaves the index unchanged
+	for (i = 0; i < 3; i++)
+		if (malloc(0) != NULL) panic("Wrong allocation: malloc(0) returns a block");
+	checkSearches(PAGE_SIZE);
+	checkSearches(USER_HEAP_MAX - USER_HEAP_START);
+	if (searchFirstFit(USER_HEAP_MAX - USER_HEAP_START) != 0) panic("Wrong allocation: malloc(0) changes the free blocks");
+
+	for (i = 0; i < 3000; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		int k = (seed >> 16) % NUM_OF_BLOCKS;
+
+		if (ptr_allocations[k] == NULL)
+		{
+			//mostly small blocks, some large ones
+			seed = seed * 1103515245 + 12345;
+			pages = 1 + (seed >> 16) % 16;
+			if ((seed >> 16) % 10 == 0) pages *= 64;
+
+			for (checkPages = 1; checkPages <= 1024; checkPages *= 2)
+				checkSearches(checkPages * PAGE_SIZE);
+			checkSearches(USER_HEAP_MAX - USER_HEAP_START);
+
+			ptr_allocations[k] = malloc(pages * PAGE_SIZE);
+			if (ptr_allocations[k] == NULL) panic("Wrong allocation: no space for %d pages", pages);
+		}
+		else
+		{
+			free(ptr_allocations[k]);
+			ptr_allocations[k] = NULL;
+		}
+	}
+
+	for (i = 0; i < NUM_OF_BLOCKS; i++)
+		if (ptr_allocations[i] != NULL)
+			free(ptr_allocations[i]);
+
+	//the heap is one free block again
+	checkSearches(USER_HEAP_MAX - USER_HEAP_START);
+	if (searchFirstFit(USER_HEAP_MAX - USER_HEAP_START) != 0) panic("Wrong free: the heap is not one free block");
+	if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 0) panic("Wrong free: Extra or less pages are removed from PageFile");
+
+	cprintf("Congratulations!! %d searches of the indexed heap match the linear scans.\n", checks);
+
+	return;
+}
@@ -0,0 +1,64 @@
+/* *********************************************************** */
+/* Tests the heap trimming: after a burst of frees (64 MB) the */
+/* page tables and the disk tables of the 4 MB spans of the    */
+/* free tail are given back to the kernel, and the spans can   */
+/* be allocated again                                          */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+void _main(void)
+{
+	int Mega = 1024*1024;
+	int i, j, round;
+
+	cprintf("This test has TWO cases. A pass message will be displayed after each one.\n");
+
+	/*CASE1: the tables of the freed blocks are released*/
+	int freeFrames = sys_calculate_free_frames() ;
+	int usedDiskPages = sys_pf_calculate_allocated_pages() ;
+	char* ptr[5];
+	for (i = 0; i < 3; i++)
+	{
+		ptr[i] = malloc(24*Mega);
+		if ((uint32) ptr[i] < USER_HEAP_START || (uint32) ptr[i] >= USER_HEAP_MAX) panic("Wrong start address for the allocated space... ");
+		ptr[i][0] = 1;
+		ptr[i][24*Mega - 1] = 2;
+	}
+	//the disk tables of the allocations and the page tables of the touched pages
+	if ((freeFrames - sys_calculate_free_frames()) < 3) panic("Wrong allocation: the tables of the range are not created");
+	for (i = 0; i < 3; i++)
+		free(ptr[i]);
+	if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 0) panic("Wrong free: Extra or less pages are removed from PageFile");
+	if ((freeFrames - sys_calculate_free_frames()) != 0) panic("Wrong trim: the tables of the free spans are not released");
+	cprintf("CASE1: (the tables of the freed blocks are released) is succeeded...\n") ;
+
+	/*CASE2: bursts of allocations on the released spans, the footprint goes back after each one*/
+	for (round = 0; round < 5; round++)
+	{
+		for (i = 0; i < 4; i++)
+			ptr[i] = malloc(8*Mega);
+		ptr[4] = malloc(40*Mega);
+		for (i = 0; i < 4; i++)
+			for (j = 0; j < 8*Mega; j += 64*PAGE_SIZE)
+				ptr[i][j] = (char) (round + i + 1);
+		for (j = 0; j < 40*Mega; j += 64*PAGE_SIZE)
+			ptr[4][j] = (char) (round + 5);
+
+		for (i = 0; i < 4; i++)
+			for (j = 0; j < 8*Mega; j += 64*PAGE_SIZE)
+				if (ptr[i][j] != (char) (round + i + 1)) panic("Wrong trim: stored values are wrongly changed!");
+		for (j = 0; j < 40*Mega; j += 64*PAGE_SIZE)
+			if (ptr[4][j] != (char) (round + 5)) panic("Wrong trim: stored values are wrongly changed!");
+
+		for (i = 0; i < 5; i++)
+			free(ptr[i]);
+		if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 0) panic("Wrong free: Extra or less pages are removed from PageFile");
+		if ((freeFrames - sys_calculate_free_frames()) != 0) panic("Wrong trim: the footprint of round %d is not released", round);
+	}
+	cprintf("CASE2: (bursts on the released spans) is succeeded...\n") ;
+
+	cprintf("Congratulations!! test heap trimming completed successfully.\n");
+
+	return;
+}
@@ -0,0 +1,72 @@
+/* *********************************************************** */
+/* Tests sys_madvise(): WILLNEED loads the pages, DONTNEED     */
+/* drops them (they come back zeroed) and SEQUENTIAL reads     */
+/* ahead and drops the pages behind the accesses               */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+void _main(void)
+{
+	int i;
+
+	cprintf("This test has THREE cases. A pass message will be displayed after each one.\n");
+
+	/*CASE1: WILLNEED loads the pages, DONTNEED drops them without writing them back*/
+	char* ptr = malloc(8*PAGE_SIZE);
+	int usedDiskPages = sys_pf_calculate_allocated_pages() ;
+	int freeFrames = sys_calculate_free_frames() ;
+	if (sys_madvise((uint32) ptr, 8*PAGE_SIZE, MADV_WILLNEED) != 0) panic("Wrong madvise: WILLNEED is refused");
+	if ((freeFrames - sys_calculate_free_frames()) < 1) panic("Wrong WILLNEED: the pages are not loaded in memory");
+	for (i = 0; i < 8*PAGE_SIZE; i += PAGE_SIZE) ptr[i] = 'x';
+
+	freeFrames = sys_calculate_free_frames() ;
+	if (sys_madvise((uint32) ptr, 8*PAGE_SIZE, MADV_DONTNEED) != 0) panic("Wrong madvise: DONTNEED is refused");
+	if ((sys_calculate_free_frames() - freeFrames) < 8) panic("Wrong DONTNEED: the pages are not removed from memory");
+	//the pages keep their reserved slots
+	if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 0) panic("Wrong DONTNEED: Extra or less pages are allocated in PageFile");
+	for (i = 0; i < 8*PAGE_SIZE; i += PAGE_SIZE)
+		if (ptr[i] != 0) panic("Wrong DONTNEED: the dropped page is not zeroed");
+	free(ptr);
+
+	//the freed range is not allocated again by DONTNEED
+	usedDiskPages = sys_pf_calculate_allocated_pages() ;
+	if (sys_madvise((uint32) ptr, 8*PAGE_SIZE, MADV_DONTNEED) != 0) panic("Wrong madvise: DONTNEED is refused");
+	if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 0) panic("Wrong DONTNEED: the pages of a free range are allocated");
+
+	if (sys_madvise(USER_HEAP_START, PAGE_SIZE, 100) != E_INVAL) panic("Wrong madvise: unknown hint is accepted");
+	if (sys_madvise(USTACKTOP - PAGE_SIZE, PAGE_SIZE, MADV_DONTNEED) != E_INVAL) panic("Wrong madvise: stack pages are dropped");
+	if (sys_madvise((uint32) ptr + 1, PAGE_SIZE, MADV_DONTNEED) != E_INVAL) panic("Wrong madvise: an unaligned range is accepted");
+	if (sys_madvise((uint32) ptr, 0, MADV_DONTNEED) != E_INVAL) panic("Wrong madvise: an empty range is accepted");
+	cprintf("CASE1: (WILLNEED and DONTNEED) is succeeded...\n") ;
+
+	/*CASE2: a SEQUENTIAL range keeps its values while its pages are dropped behind the accesses*/
+	int pages = 256, run;
+	for (run = 0; run < 2; run++)
+	{
+		int* arr = malloc(pages*PAGE_SIZE);
+		if (run == 1 && sys_madvise((uint32) arr, pages*PAGE_SIZE, MADV_SEQUENTIAL) != 0)
+			panic("Wrong madvise: SEQUENTIAL is refused");
+
+		struct uint64 start = sys_get_virtual_time();
+		for (i = 0; i < pages*PAGE_SIZE/sizeof(int); i += PAGE_SIZE/sizeof(int)) arr[i] = i;
+		for (i = 0; i < pages*PAGE_SIZE/sizeof(int); i += PAGE_SIZE/sizeof(int))
+			if (arr[i] != i) panic("Wrong SEQUENTIAL: stored values are wrongly changed!");
+		cprintf("%s: %d\n", run == 0 ? "no hint" : "SEQUENTIAL", get_virtual_time_since(start));
+		free(arr);
+	}
+	cprintf("CASE2: (SEQUENTIAL) is succeeded...\n") ;
+
+	/*CASE3: the hints of a range are limited, NORMAL removes them*/
+	for (i = 0; i < MAX_MEM_ADVICES; i++)
+		if (sys_madvise(USER_HEAP_START + 2*i*PAGE_SIZE, PAGE_SIZE, MADV_RANDOM) != 0) panic("Wrong madvise: RANDOM is refused");
+	if (sys_madvise(USER_HEAP_START + 2*i*PAGE_SIZE, PAGE_SIZE, MADV_RANDOM) != E_NO_MEM) panic("Wrong madvise: extra hints are kept");
+	if (sys_madvise(USER_HEAP_START, 2*MAX_MEM_ADVICES*PAGE_SIZE, MADV_NORMAL) != 0) panic("Wrong madvise: NORMAL is refused");
+	if (sys_madvise(USER_HEAP_START, PAGE_SIZE, MADV_SEQUENTIAL) != 0) panic("Wrong madvise: the hints are not removed");
+	sys_madvise(USER_HEAP_START, PAGE_SIZE, MADV_NORMAL);
+	cprintf("CASE3: (hints limit) is succeeded...\n") ;
+
+	cprintf("Congratulations!! test madvise completed successfully.\n");
+
+	return;
+}
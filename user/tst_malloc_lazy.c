@@ -0,0 +1,60 @@
+/* *********************************************************** */
+/* Tests the zero-fill-on-demand heap: malloc() takes no pages */
+/* in memory, the first access gives a zeroed page and the     */
+/* modified pages survive their eviction                       */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+void _main(void)
+{
+	int Mega = 1024*1024;
+	int kilo = 1024;
+	int i;
+
+	cprintf("This test has THREE cases. A pass message will be displayed after each one.\n");
+
+	/*CASE1: malloc takes only the disk tables of the range*/
+	int freeFrames = sys_calculate_free_frames() ;
+	int usedDiskPages = sys_pf_calculate_allocated_pages() ;
+	char* ptr = malloc(16*Mega);
+	if ((uint32) ptr < USER_HEAP_START || (uint32) ptr >= USER_HEAP_MAX) panic("Wrong start address for the allocated space... ");
+	//one disk table for each 4 MB
+	if ((freeFrames - sys_calculate_free_frames()) != 4) panic("Wrong allocation: pages are allocated in memory");
+	//the page file slots of the pages are reserved
+	if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 16*Mega/PAGE_SIZE) panic("Extra or less pages are allocated in PageFile");
+	cprintf("CASE1: (malloc takes only the disk tables of the range) is succeeded...\n") ;
+
+	/*CASE2: the first access gives a zeroed page, the modified pages survive their eviction*/
+	for (i = 0; i < 200; i++)
+	{
+		if (ptr[i * 20 * PAGE_SIZE + i] != 0) panic("Wrong first access: the page is not zeroed");
+		ptr[i * 20 * PAGE_SIZE + i] = (char) (i + 1);
+	}
+	for (i = 0; i < 200; i++)
+		if (ptr[i * 20 * PAGE_SIZE + i] != (char) (i + 1)) panic("Wrong eviction: stored values are wrongly changed!");
+	//the evicted pages took their reserved slots
+	if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 16*Mega/PAGE_SIZE) panic("Extra or less pages are allocated in PageFile");
+
+	free(ptr);
+	if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 0) panic("Wrong free: Extra or less pages are removed from PageFile");
+	cprintf("CASE2: (zeroed first access and eviction of modified pages) is succeeded...\n") ;
+
+	/*CASE3: malloc time does not depend on the size*/
+	uint32 size;
+	cprintf("size (KB)\tmalloc time\n");
+	for (size = 4*kilo; size <= 64*Mega; size *= 4)
+	{
+		struct uint64 start = sys_get_virtual_time();
+		ptr = malloc(size);
+		uint32 time = get_virtual_time_since(start);
+		if (ptr == NULL) panic("Wrong allocation: no space for %d KB", size / kilo);
+		free(ptr);
+		cprintf("%d\t\t%d\n", size / kilo, time);
+	}
+	cprintf("CASE3: (malloc time versus size) is completed...\n") ;
+
+	cprintf("Congratulations!! test zero-fill-on-demand malloc completed successfully.\n");
+
+	return;
+}
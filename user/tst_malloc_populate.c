@@ -0,0 +1,100 @@
+/* *********************************************************** */
+/* Tests malloc_populate(): the pages of the block are loaded  */
+/* with the allocation (up to the free working set entries),   */
+/* and measures the first touch of the block against malloc()  */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+//the pages of the program are written to the page file at its load, on consecutive disk frames
+char arr[64*PAGE_SIZE];
+
+void _main(void)
+{
+	int kilo = 1024;
+	int i;
+
+	volatile struct Env* myEnv;
+	myEnv = &(envs[sys_getenvid()]);
+
+	cprintf("This test has THREE cases. A pass message will be displayed after each one.\n");
+
+	//[0] Make sure there're available places in the WS for the populated pages
+	int numOfEmptyWSLocs = 0;
+	for (i = 0 ; i < myEnv->page_WS_max_size; i++)
+		if (myEnv->__uptr_pws[i].empty == 1)
+			numOfEmptyWSLocs++;
+	if (numOfEmptyWSLocs < 8)
+		panic("Insufficient number of WS empty locations! please increase the PAGE_WS_MAX_SIZE");
+
+	/*CASE1: the pages are in memory after the allocation, they are zeroed*/
+	int freeFrames = sys_calculate_free_frames() ;
+	int usedDiskPages = sys_pf_calculate_allocated_pages() ;
+	char* ptr = malloc_populate(8*PAGE_SIZE);
+	if ((uint32) ptr < USER_HEAP_START || (uint32) ptr >= USER_HEAP_MAX) panic("Wrong start address for the allocated space... ");
+	//the loaded pages, and the page table and the disk table of the range if they are new
+	int usedFrames = freeFrames - sys_calculate_free_frames();
+	if (usedFrames < 8 || usedFrames > 8 + 2) panic("Wrong populate: the pages are not loaded in memory");
+	if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 8) panic("Extra or less pages are allocated in PageFile");
+
+	//exactly the pages of the block are added to the WS
+	int pagesInWS = 0;
+	for (i = 0 ; i < myEnv->page_WS_max_size; i++)
+		if (myEnv->__uptr_pws[i].empty == 0 && myEnv->__uptr_pws[i].virtual_address >= (uint32) ptr
+				&& myEnv->__uptr_pws[i].virtual_address < (uint32) ptr + 8*PAGE_SIZE)
+			pagesInWS++;
+	if (pagesInWS != 8) panic("Wrong populate: %d pages of the block are in the WS instead of 8", pagesInWS);
+
+	//the accesses to the block don't fault
+	uint32 faults = myEnv->pageFaultsCounter;
+	for (i = 0; i < 8*PAGE_SIZE; i += PAGE_SIZE)
+	{
+		if (ptr[i] != 0) panic("Wrong populate: the page is not zeroed");
+		ptr[i] = (char) (i / PAGE_SIZE + 1);
+	}
+	if (myEnv->pageFaultsCounter != faults) panic("Wrong populate: %d faults on the populated pages", myEnv->pageFaultsCounter - faults);
+	for (i = 0; i < 8*PAGE_SIZE; i += PAGE_SIZE)
+		if (ptr[i] != (char) (i / PAGE_SIZE + 1)) panic("Wrong populate: stored values are wrongly changed!");
+	free(ptr);
+	if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 0) panic("Wrong free: Extra or less pages are removed from PageFile");
+	cprintf("CASE1: (the pages are loaded with the allocation) is succeeded...\n") ;
+
+	/*CASE2: first touch of a block allocated by malloc() and by malloc_populate()*/
+	uint32 size;
+	cprintf("size (KB)\tmalloc+touch\tmalloc_populate+touch\n");
+	for (size = 16*kilo; size <= 64*kilo; size *= 2)
+	{
+		struct uint64 start = sys_get_virtual_time();
+		ptr = malloc(size);
+		for (i = 0; i < size; i += PAGE_SIZE) ptr[i] = 1;
+		uint32 faultTime = get_virtual_time_since(start);
+		free(ptr);
+
+		start = sys_get_virtual_time();
+		ptr = malloc_populate(size);
+		for (i = 0; i < size; i += PAGE_SIZE) ptr[i] = 1;
+		uint32 populateTime = get_virtual_time_since(start);
+		free(ptr);
+
+		cprintf("%d\t\t%d\t\t%d\n", size / kilo, faultTime, populateTime);
+	}
+	cprintf("CASE2: (first touch time) is completed...\n") ;
+
+	/*CASE3: the consecutive pages of the page file are loaded by one disk transfer*/
+	//the last pages of the array are not loaded with the program
+	uint32 start = ROUNDUP((uint32) arr, PAGE_SIZE) + 48*PAGE_SIZE;
+	uint32 reads = myEnv->pageFileReadsCounter;
+	uint32 transfers = myEnv->pageFileTransfersCounter;
+	if (sys_madvise(start, 8*PAGE_SIZE, MADV_WILLNEED) != 0) panic("Wrong madvise: WILLNEED is refused");
+	reads = myEnv->pageFileReadsCounter - reads;
+	transfers = myEnv->pageFileTransfersCounter - transfers;
+	if (reads < 2) panic("Wrong populate: %d pages of the array are read from the page file", reads);
+	if (transfers != 1) panic("Wrong populate: %d pages are read by %d disk transfers instead of 1", reads, transfers);
+	for (i = 0; i < 8*PAGE_SIZE; i += PAGE_SIZE)
+		if (((char*) start)[i] != 0) panic("Wrong populate: the page is not read correctly");
+	cprintf("CASE3: (one disk transfer for consecutive pages) is succeeded...\n") ;
+
+	cprintf("Congratulations!! test malloc_populate completed successfully.\n");
+
+	return;
+}
@@ -0,0 +1,75 @@
+/* *********************************************************** */
+/* MAKE SURE PAGE_WS_MAX_SIZE = 1000 */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+void _main(void)
+{
+	int kilo = 1024;
+	int* ptr_allocations[1000] = {0};
+	int i;
+
+	cprintf("This test has THREE cases. A pass message will be displayed after each one.\n");
+
+	/*CASE1: small objects share the heap pages*/
+	{
+		int usedDiskPages = sys_pf_calculate_allocated_pages() ;
+		for (i = 0; i < 1000; i++)
+		{
+			ptr_allocations[i] = malloc(sizeof(int));
+			if ((uint32) ptr_allocations[i] < USER_HEAP_START || (uint32) ptr_allocations[i] >= USER_HEAP_MAX) panic("Wrong start address for the allocated space... ");
+			if ((uint32) ptr_allocations[i] % PAGE_SIZE == 0) panic("Small object is allocated on a page boundary");
+			*ptr_allocations[i] = i;
+		}
+		//253 objects of 16 bytes fit in one page
+		if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 4) panic("Extra or less pages are allocated in PageFile");
+
+		for (i = 0; i < 1000; i++)
+			if (*ptr_allocations[i] != i) panic("Wrong allocation: stored values are wrongly changed!");
+
+		for (i = 0; i < 1000; i++)
+			free(ptr_allocations[i]);
+		//one empty page is kept for the next allocations
+		if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 1) panic("Wrong free: Extra or less pages are removed from PageFile");
+
+		cprintf("CASE1: (small objects share the heap pages) is succeeded...\n") ;
+	}
+
+	/*CASE2: size classes and realloc*/
+	{
+		char* x = malloc(24);
+		char* y = malloc(100);
+		char* z = malloc(1000);
+		if (ROUNDDOWN((uint32) x, PAGE_SIZE) == ROUNDDOWN((uint32) y, PAGE_SIZE) || ROUNDDOWN((uint32) y, PAGE_SIZE) == ROUNDDOWN((uint32) z, PAGE_SIZE))
+			panic("Objects of different size classes share a page");
+
+		for (i = 0; i < 24; i++) x[i] = i;
+		x = realloc(x, 500);
+		for (i = 0; i < 24; i++)
+			if (x[i] != i) panic("Wrong re-allocation: stored values are wrongly changed!");
+		if (realloc(x, 300) != x) panic("Wrong re-allocation: the object is moved although it fits in its size class");
+
+		free(x);
+		free(y);
+		free(z);
+
+		cprintf("CASE2: (size classes and realloc) is succeeded...\n") ;
+	}
+
+	/*CASE3: larger blocks (1 KB and more) still take whole pages*/
+	{
+		int usedDiskPages = sys_pf_calculate_allocated_pages() ;
+		void* ptr = malloc(kilo);
+		if ((uint32) ptr % PAGE_SIZE != 0) panic("Wrong start address for the allocated space... ");
+		if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 1) panic("Extra or less pages are allocated in PageFile");
+		free(ptr);
+		if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 0) panic("Wrong free: Extra or less pages are removed from PageFile");
+
+		cprintf("CASE3: (larger blocks still take whole pages) is succeeded...\n") ;
+	}
+
+	cprintf("Congratulations!! test small objects malloc completed successfully.\n");
+
+	return;
+}
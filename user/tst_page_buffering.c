@@ -0,0 +1,57 @@
+/* *********************************************************** */
+/* Tests the page buffering: the victims of the replacement    */
+/* stay in the free/modified frame lists, and faulting on them */
+/* again reclaims the frame without reading the page file.     */
+/* MAKE SURE the buffering is enabled (run "buff" first)       */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+#define NUM_OF_PAGES 24
+
+char arr[PAGE_SIZE*NUM_OF_PAGES];
+
+void _main(void)
+{
+	int envID = sys_getenvid();
+	volatile struct Env* myEnv;
+	myEnv = &(envs[envID]);
+
+	int i, round;
+	if (NUM_OF_PAGES <= myEnv->page_WS_max_size) panic("the WS is too large for this test, run it with a WS smaller than %d", NUM_OF_PAGES);
+
+	cprintf("This test has TWO cases. A pass message will be displayed after each one.\n");
+
+	/*CASE1: the victims are buffered instead of released*/
+	//writing (modified) then reading (not modified) a range larger than the WS
+	for (i = 0; i < NUM_OF_PAGES; i++)
+		arr[i*PAGE_SIZE] = (char) (i + 1);
+	char garbage = 0;
+	for (i = 0; i < NUM_OF_PAGES; i++)
+		garbage += arr[i*PAGE_SIZE + PAGE_SIZE/2];
+	if ((sys_calculate_notmod_frames() + sys_calculate_modified_frames()) == 0)
+		panic("no buffered frames are found, make sure the buffering is enabled (run \"buff\" first)");
+	cprintf("CASE1: (the victims are buffered) is succeeded...\n") ;
+
+	/*CASE2: re-touching the evicted pages never reads the page file*/
+	uint32 reads = myEnv->pageFileReadsCounter;
+	uint32 faults = myEnv->pageFaultsCounter;
+	for (round = 0; round < 3; round++)
+	{
+		for (i = 0; i < NUM_OF_PAGES; i++)
+			if (arr[i*PAGE_SIZE] != (char) (i + 1)) panic("Wrong buffering: stored values are wrongly changed!");
+		for (i = NUM_OF_PAGES - 1; i >= 0; i--)
+			arr[i*PAGE_SIZE + 1] = (char) (round + i);
+	}
+	for (i = 0; i < NUM_OF_PAGES; i++)
+		if (arr[i*PAGE_SIZE + 1] != (char) (2 + i)) panic("Wrong buffering: stored values are wrongly changed!");
+	if (myEnv->pageFaultsCounter == faults) panic("Wrong buffering: no replacement is done, review the size of the WS");
+	if (myEnv->pageFileReadsCounter != reads)
+		panic("Wrong buffering: %d pages are read again from the page file", myEnv->pageFileReadsCounter - reads);
+	cprintf("CASE2: (%d faults reclaimed without reading the page file) is succeeded...\n", myEnv->pageFaultsCounter - faults) ;
+
+	USED(garbage);
+	cprintf("Congratulations!! test page buffering completed successfully.\n");
+
+	return;
+}
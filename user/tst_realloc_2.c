@@ -341,11 +341,12 @@ void _main(void)
 		if ((uint32) ptr_allocations[7] != (USER_HEAP_START + 2*Mega) && (uint32) ptr_allocations[7] != (USER_HEAP_START + 19*Mega)) panic("Wrong start address for the re-allocated space... ");
 		if ((uint32) ptr_allocations[7] == (USER_HEAP_START + 2*Mega))
 		{
-			if ((sys_calculate_free_frames() - freeFrames) != 768 + 2) panic("Wrong re-allocation: either extra pages are allocated in memory or pages not removed correctly when moving the reallocated block");
+			//the moved pages stay in the memory (zero-copy realloc)
+			if ((sys_calculate_free_frames() - freeFrames) != 0) panic("Wrong re-allocation: either extra pages are allocated in memory or pages not removed correctly when moving the reallocated block");
 		}
 		else if ((uint32) ptr_allocations[7] == (USER_HEAP_START + 19*Mega))
 		{
-			if ((sys_calculate_free_frames() - freeFrames) != 768 + 2 - 1) panic("Wrong re-allocation: either extra pages are allocated in memory or pages not removed correctly when moving the reallocated block");
+			if ((freeFrames - sys_calculate_free_frames()) != 1) panic("Wrong re-allocation: either extra pages are allocated in memory or pages not removed correctly when moving the reallocated block");
 		}
 		if ((sys_pf_calculate_allocated_pages() - usedDiskPages) != 256) panic("Extra or less pages are allocated in PageFile");
 
@@ -358,7 +359,7 @@ void _main(void)
 			intArr[i] = i ;
 		}
 
-		if ((freeFrames - sys_calculate_free_frames()) != 256 + 1) panic("Wrong placement when accessing the allocated space");
+		if ((freeFrames - sys_calculate_free_frames()) != 256) panic("Wrong placement when accessing the allocated space");
 
 		freeFrames = sys_calculate_free_frames() ;
 		for (i=0; i < lastIndexOfInt2 ; i++)
@@ -366,7 +367,7 @@ void _main(void)
 			cnt++;
 			if (intArr[i] != i) panic("Wrong re-allocation: stored values are wrongly changed!");
 		}
-		if ((freeFrames - sys_calculate_free_frames()) != 768 + 1) panic("Wrong placement when accessing the allocated space");
+		if ((freeFrames - sys_calculate_free_frames()) != 0) panic("Wrong placement when accessing the allocated space");
 
 		//[3] test freeing it after expansion
 		freeFrames = sys_calculate_free_frames() ;
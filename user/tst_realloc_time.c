@@ -0,0 +1,50 @@
+/* *********************************************************** */
+/* Measures the cost of realloc() that moves a block compared  */
+/* to malloc() + copy + free() of the same block               */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+void _main(void)
+{
+	int kilo = 1024;
+	int Mega = 1024*1024;
+	uint32 size, i;
+
+	cprintf("size (KB)\trealloc\t\tmalloc+copy+free\n");
+	for (size = 16*kilo; size <= 1*Mega; size *= 2)
+	{
+		//[1] realloc: the block can't grow in its place, so its pages are moved
+		char* block = malloc(size);
+		for (i = 0; i < size; i += PAGE_SIZE) block[i] = i;
+		char* blocker = malloc(PAGE_SIZE);
+
+		struct uint64 start = sys_get_virtual_time();
+		char* moved = realloc(block, 2*size);
+		uint32 reallocTime = get_virtual_time_since(start);
+
+		if (moved == block) panic("the block is not moved");
+		for (i = 0; i < size; i += PAGE_SIZE)
+			if (moved[i] != (char)i) panic("Wrong realloc: stored values are wrongly changed!");
+		free(moved);
+		free(blocker);
+
+		//[2] the same move done by copying the pages
+		block = malloc(size);
+		for (i = 0; i < size; i += PAGE_SIZE) block[i] = i;
+		blocker = malloc(PAGE_SIZE);
+
+		start = sys_get_virtual_time();
+		char* copy = malloc(2*size);
+		for (i = 0; i < size; i++) copy[i] = block[i];
+		free(block);
+		uint32 copyTime = get_virtual_time_since(start);
+
+		free(copy);
+		free(blocker);
+
+		cprintf("%d\t\t%d\t\t%d\n", size / kilo, reallocTime, copyTime);
+	}
+
+	cprintf("realloc timing is completed.\n");
+}
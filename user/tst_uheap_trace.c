@@ -0,0 +1,51 @@
+/* *********************************************************** */
+/* A mix of heap calls to trace (command: uheaptrace), the     */
+/* trace of the run is shown by the command: uheapstats <id>   */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+#define BLOCKS 64
+
+void _main(void)
+{
+	int kilo = 1024;
+	void* blocks[BLOCKS];
+	int i, round;
+
+	if (!sys_uheap_trace(NULL))
+		cprintf("The user heap tracing is off, enable it by the command: uheaptrace\n");
+
+	for (i = 0; i < BLOCKS; i++)
+		blocks[i] = NULL;
+
+	//small objects, blocks of pages and resizes, half of the blocks are freed each round
+	for (round = 0; round < 8; round++)
+	{
+		for (i = 0; i < BLOCKS; i++)
+		{
+			if (blocks[i] != NULL)
+				continue;
+			uint32 size = (i % 4 == 0) ? 16 << (i % 7) : ((i * 7 + round) % 32 + 1) * 4 * kilo;
+			blocks[i] = malloc(size);
+			if (blocks[i] == NULL) panic("Wrong allocation: no space for %d bytes", size);
+		}
+		for (i = round % 2; i < BLOCKS; i += 2)
+		{
+			if (i % 5 == 0)
+				blocks[i] = realloc(blocks[i], ((i + round) % 16 + 1) * 8 * kilo);
+			else
+			{
+				free(blocks[i]);
+				blocks[i] = NULL;
+			}
+		}
+	}
+	for (i = 0; i < BLOCKS; i++)
+		if (blocks[i] != NULL)
+			free(blocks[i]);
+
+	cprintf("Heap calls are completed, see their trace by the command: uheapstats %d\n", sys_getenvid());
+
+	return;
+}